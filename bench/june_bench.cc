@@ -0,0 +1,275 @@
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+
+#include "absl/strings/str_format.h"
+#include "src/compiler.h"
+#include "src/embed.h"
+#include "src/evaluator.h"
+#include "src/instr.h"
+#include "src/native.h"
+#include "src/parser.h"
+#include "src/program.h"
+#include "src/scanner.h"
+#include "src/vm.h"
+
+namespace {
+
+// (if #t (if #t ... 1 0) 0)
+std::string nested_if(int depth) {
+    std::string s;
+    for (int i = 0; i < depth; i++) s += "(if #t ";
+    s += "1";
+    for (int i = 0; i < depth; i++) s += " 0)";
+    return s;
+}
+
+// (let ((x0 0) (x1 x0) (x2 x1) ...) xN)
+std::string wide_let(int width) {
+    std::string s = "(let ((x0 0)";
+    for (int i = 1; i < width; i++) {
+        s += absl::StrFormat(" (x%d x%d)", i, i - 1);
+    }
+    return s + absl::StrFormat(") x%d)", width - 1);
+}
+
+// many independent top-level statements
+std::string statements(int count) {
+    std::string s;
+    for (int i = 0; i < count; i++) {
+        s += absl::StrFormat("(let ((a %d) (b #t)) (if b a 0))\n", i);
+    }
+    return s;
+}
+
+// many statements that each build a short list and take it apart
+std::string lists(int count) {
+    std::string s;
+    for (int i = 0; i < count; i++) {
+        s += absl::StrFormat("(car (cdr (cons %d (cons %d nil))))\n", i, i);
+    }
+    return s;
+}
+
+// many statements that each make nested calls to a small function
+std::string calls(int count) {
+    std::string s = "(define (f x) (let ((y x)) y))\n";
+    for (int i = 0; i < count; i++) {
+        s += absl::StrFormat("(f (f (f %d)))\n", i);
+    }
+    return s;
+}
+
+// a tail-recursive loop that sums the integers up to |count|
+std::string sum(int count) {
+    return absl::StrFormat(
+        "(define (sum n acc) (if (= n 0) acc (sum (- n 1) (+ acc n))))\n"
+        "(sum %d 0)\n",
+        count);
+}
+
+// the factorial of |count|, which promotes to a bignum past 20!
+std::string factorial(int count) {
+    return absl::StrFormat(
+        "(define (fact n acc) (if (= n 0) acc (fact (- n 1) (* acc n))))\n"
+        "(fact %d 1)\n",
+        count);
+}
+
+// the tokens point into |symbols|, which must outlive them
+std::vector<Token> must_scan(std::string_view text, SymbolTable* symbols) {
+    auto toks = scan(text, symbols);
+    if (!toks.ok()) abort();
+    return *std::move(toks);
+}
+
+std::vector<Stmt> must_parse(std::string_view text, SymbolTable* symbols,
+                             Arena* arena) {
+    auto stmts = parse(must_scan(text, symbols), arena);
+    if (!stmts.ok()) abort();
+    return *std::move(stmts);
+}
+
+Chunk must_compile(std::string_view text) {
+    SymbolTable symbols;
+    Arena arena;
+    auto chunk = Compiler().compile(must_parse(text, &symbols, &arena));
+    if (!chunk.ok()) abort();
+    return *std::move(chunk);
+}
+
+void BM_Scan(benchmark::State& state, std::string (*gen)(int)) {
+    std::string text = gen(state.range(0));
+    SymbolTable symbols;
+    for (auto _ : state) benchmark::DoNotOptimize(scan(text, &symbols));
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+void BM_Parse(benchmark::State& state, std::string (*gen)(int)) {
+    std::string text = gen(state.range(0));
+    SymbolTable symbols;
+    auto toks = must_scan(text, &symbols);
+    for (auto _ : state) {
+        Arena arena;
+        benchmark::DoNotOptimize(parse(toks, &arena));
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+void BM_Compile(benchmark::State& state, std::string (*gen)(int)) {
+    std::string text = gen(state.range(0));
+    SymbolTable symbols;
+    Arena arena;
+    auto stmts = must_parse(text, &symbols, &arena);
+    Compiler compiler;
+    for (auto _ : state) benchmark::DoNotOptimize(compiler.compile(stmts));
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+// Loads |chunk| once, so that the benchmarks below time only running it
+std::shared_ptr<const Program> must_load(const Chunk& chunk) {
+    auto program = Program::load(chunk.view());
+    if (!program.ok()) abort();
+    return *std::move(program);
+}
+
+// Reports the instructions run per second. Running the program is
+// deterministic, so one counted run up front gives the number of
+// instructions in each timed run; with the jit that's the number of
+// bytecode instructions the native code stands in for.
+void BM_Execute(benchmark::State& state, std::string (*gen)(int),
+                bool jit = false) {
+    auto program = must_load(must_compile(gen(state.range(0))));
+    VM counter;
+    counter.set_count_instructions(true);
+    if (!counter.execute(program).ok()) abort();
+    for (auto _ : state) {
+        // a vm keeps the globals a program defines, so start from a fresh one
+        VM vm;
+        vm.set_jit(jit);
+        if (!vm.execute(program).ok()) abort();
+    }
+    state.counters["instructions"] = benchmark::Counter(
+        counter.instructions_run() * state.iterations(),
+        benchmark::Counter::kIsRate);
+}
+
+// naive recursive fib, which is all calls and integer arithmetic
+void BM_Fib(benchmark::State& state, bool jit) {
+    auto program = must_load(must_compile(absl::StrFormat(
+        "(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))\n"
+        "(fib %d)\n",
+        state.range(0))));
+    for (auto _ : state) {
+        VM vm;
+        vm.set_jit(jit);
+        if (!vm.execute(program).ok()) abort();
+    }
+}
+
+// the same fib with define-memo, which makes a linear number of calls
+void BM_FibMemo(benchmark::State& state) {
+    auto program = must_load(must_compile(absl::StrFormat(
+        "(define-memo (fib n) "
+        "(if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))\n"
+        "(fib %d)\n",
+        state.range(0))));
+    for (auto _ : state) {
+        VM vm;
+        if (!vm.execute(program).ok()) abort();
+    }
+}
+
+// running a whole script of |range| statements, either as one batch or one
+// statement at a time
+void BM_Script(benchmark::State& state, bool streaming) {
+    std::string text = calls(state.range(0));
+    for (auto _ : state) {
+        Evaluator eval([](absl::Status) { abort(); });
+        eval.set_optimize(true);
+        if (streaming) eval.run_script(text);
+        else eval.evaluate(text);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+// serving a request that runs a script: either compiling the script from
+// source each time, or running a program compiled up front on a new isolate
+void BM_Request(benchmark::State& state, bool shared) {
+    std::string text = calls(state.range(0));
+    auto program = compile_program(text);
+    if (!program.ok()) abort();
+    for (auto _ : state) {
+        std::shared_ptr<const Program> code = *program;
+        if (!shared) {
+            auto compiled = compile_program(text);
+            if (!compiled.ok()) abort();
+            code = *std::move(compiled);
+        }
+        Isolate isolate(std::move(code));
+        if (!isolate.run().ok()) abort();
+    }
+}
+
+// a loop that calls square |range| times, either as a native function or
+// as one defined in the script
+void BM_CallSquare(benchmark::State& state, bool native) {
+    auto natives = std::make_shared<Natives>();
+    if (native && !natives->define("square", [](int64_t x) { return x * x; })
+                       .ok()) {
+        abort();
+    }
+    std::string text = absl::StrFormat(
+        "%s"
+        "(define (loop n acc) (if (= n 0) acc "
+        "(loop (- n 1) (+ acc (square n)))))\n"
+        "(loop %d 0)\n",
+        native ? "" : "(define (square x) (* x x))\n", state.range(0));
+    auto program = compile_program(text, {.natives = natives});
+    if (!program.ok()) abort();
+    for (auto _ : state) {
+        Isolate isolate(*program);
+        if (!isolate.run().ok()) abort();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+#define JUNE_BENCHMARK(bm, gen) \
+    BENCHMARK_CAPTURE(bm, gen, gen)->RangeMultiplier(8)->Range(8, 4096)
+#define JUNE_BENCHMARKS(gen)          \
+    JUNE_BENCHMARK(BM_Scan, gen);    \
+    JUNE_BENCHMARK(BM_Parse, gen);   \
+    JUNE_BENCHMARK(BM_Compile, gen); \
+    JUNE_BENCHMARK(BM_Execute, gen);
+
+JUNE_BENCHMARKS(nested_if)
+JUNE_BENCHMARKS(wide_let)
+JUNE_BENCHMARKS(statements)
+JUNE_BENCHMARKS(lists)
+JUNE_BENCHMARKS(calls)
+JUNE_BENCHMARKS(sum)
+JUNE_BENCHMARKS(factorial)
+
+BENCHMARK_CAPTURE(BM_Execute, sum_jit, sum, true)
+    ->RangeMultiplier(8)
+    ->Range(8, 4096);
+BENCHMARK_CAPTURE(BM_Fib, interpreted, false)->DenseRange(15, 25, 5);
+BENCHMARK_CAPTURE(BM_Fib, jit, true)->DenseRange(15, 25, 5);
+BENCHMARK(BM_FibMemo)->DenseRange(15, 25, 5);
+BENCHMARK_CAPTURE(BM_CallSquare, native, true)->Arg(100000);
+BENCHMARK_CAPTURE(BM_CallSquare, script, false)->Arg(100000);
+BENCHMARK_CAPTURE(BM_Script, batch, false)
+    ->RangeMultiplier(8)
+    ->Range(8, 32768);
+BENCHMARK_CAPTURE(BM_Script, streaming, true)
+    ->RangeMultiplier(8)
+    ->Range(8, 32768);
+BENCHMARK_CAPTURE(BM_Request, from_source, false)
+    ->RangeMultiplier(8)
+    ->Range(8, 512);
+BENCHMARK_CAPTURE(BM_Request, shared_program, true)
+    ->RangeMultiplier(8)
+    ->Range(8, 512);
+
+}  // namespace
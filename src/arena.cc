@@ -0,0 +1,36 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+constexpr size_t kMinBlockSize = 4096;
+constexpr size_t kMaxBlockSize = 1 << 20;
+}  // namespace
+
+void* Arena::allocate(size_t size, size_t align) {
+    auto addr = reinterpret_cast<uintptr_t>(next_);
+    size_t padding = (align - addr % align) % align;
+    if (next_ == nullptr || padding + size > end_ - next_) {
+        // blocks grow with the arena so that large parses need few of them
+        size_t block_size = std::clamp(reserved_, kMinBlockSize, kMaxBlockSize);
+        block_size = std::max(block_size, size + align);
+        blocks_.emplace_back(new char[block_size]);
+        reserved_ += block_size;
+        next_ = blocks_.back().get();
+        end_ = next_ + block_size;
+        addr = reinterpret_cast<uintptr_t>(next_);
+        padding = (align - addr % align) % align;
+    }
+    void* p = next_ + padding;
+    next_ += padding + size;
+    return p;
+}
+
+std::string_view Arena::copy(std::string_view s) {
+    if (s.empty()) return {};
+    char* p = static_cast<char*>(allocate(s.size(), 1));
+    std::memcpy(p, s.data(), s.size());
+    return {p, s.size()};
+}
@@ -0,0 +1,63 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+
+// A bump allocator. Objects allocated in an arena are never destroyed
+// individually: all of their memory is released at once when the arena is
+// destroyed, so only trivially destructible types may be allocated.
+class Arena final {
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&& other)
+        : blocks_(std::move(other.blocks_)),
+          next_(std::exchange(other.next_, nullptr)),
+          end_(std::exchange(other.end_, nullptr)),
+          reserved_(std::exchange(other.reserved_, 0)) {}
+
+    void* allocate(size_t size, size_t align);
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "arena objects are never destroyed");
+        void* p = allocate(sizeof(T), alignof(T));
+        return new (p) T(std::forward<Args>(args)...);
+    }
+
+    // copies |items| into the arena
+    template <typename T>
+    absl::Span<const T> copy(absl::Span<const T> items) {
+        static_assert(std::is_trivially_copyable_v<T>,
+                      "arena arrays are copied bytewise");
+        if (items.empty()) return {};
+        void* p = allocate(sizeof(T) * items.size(), alignof(T));
+        std::memcpy(p, items.data(), sizeof(T) * items.size());
+        return {static_cast<const T*>(p), items.size()};
+    }
+
+    // copies |s| into the arena
+    std::string_view copy(std::string_view s);
+
+    // total bytes reserved from the system
+    size_t bytes_reserved() const { return reserved_; }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* next_ = nullptr;
+    char* end_ = nullptr;
+    size_t reserved_ = 0;
+};
+
+#endif  // ARENA_H_
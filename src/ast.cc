@@ -15,8 +15,10 @@ struct Printer {
         return std::to_string(e.value);
     }
 
+    std::string operator()(const NilExpr& e) const { return "nil"; }
+
     std::string operator()(const SymbolExpr& e) const {
-        return "Symbol(" + e.name + ")";
+        return "Symbol(" + std::string(e.symbol.name) + ")";
     }
 
     std::string operator()(const IfExpr& e) const {
@@ -27,18 +29,83 @@ struct Printer {
     std::string operator()(const LetExpr& e) const {
         std::string s = "Let(";
         for (const auto& [k, v] : e.bindings) {
-            s.append("[" + k + " -> " + to_string(v) + "]");
+            s.append("[" + std::string(k.name) + " -> " + to_string(*v) +
+                     "]");
         }
         return s + ")";
     }
+
+    std::string operator()(const BuiltinExpr& e) const {
+        std::string s = "Builtin(" + to_string(e.op);
+        for (const Expr* arg : e.args) s.append(", " + to_string(*arg));
+        return s + ")";
+    }
+
+    std::string operator()(const LambdaExpr& e) const {
+        std::string s = "Lambda(";
+        for (const auto& param : e.params) {
+            s.append("[" + std::string(param.name) + "]");
+        }
+        return s + ", " + to_string(*e.body) + ")";
+    }
+
+    std::string operator()(const CallExpr& e) const {
+        std::string s = "Call(" + to_string(*e.fn);
+        for (const Expr* arg : e.args) s.append(", " + to_string(*arg));
+        return s + ")";
+    }
+
+    std::string operator()(const DefineStmt& s) const {
+        return (s.memo ? "DefineMemo(" : "Define(") +
+               std::string(s.name.name) + ", " +
+               to_string(*s.value) + ")";
+    }
 };
 
-std::string to_string(const Expr& expr) {
-    static const Printer printer;
-    return std::visit(printer, expr);
+std::string to_string(Builtin op) {
+    switch (op) {
+        case Builtin::Cons: return "cons";
+        case Builtin::Car: return "car";
+        case Builtin::Cdr: return "cdr";
+        case Builtin::IsNil: return "nil?";
+        case Builtin::Add: return "+";
+        case Builtin::Sub: return "-";
+        case Builtin::Mul: return "*";
+        case Builtin::Lt: return "<";
+        case Builtin::Gt: return ">";
+        case Builtin::Eq: return "=";
+    }
 }
 
-std::string to_string(const Stmt& stmt) {
-    static const Printer printer;
-    return std::visit(printer, stmt);
+int arity(Builtin op) {
+    switch (op) {
+        case Builtin::Cons:
+        case Builtin::Add:
+        case Builtin::Sub:
+        case Builtin::Mul:
+        case Builtin::Lt:
+        case Builtin::Gt:
+        case Builtin::Eq: return 2;
+        case Builtin::Car:
+        case Builtin::Cdr:
+        case Builtin::IsNil: return 1;
+    }
 }
+
+std::optional<Builtin> lookup_builtin(std::string_view name) {
+    if (name == "cons") return Builtin::Cons;
+    if (name == "car") return Builtin::Car;
+    if (name == "cdr") return Builtin::Cdr;
+    if (name == "nil?") return Builtin::IsNil;
+    if (name == "+") return Builtin::Add;
+    if (name == "-") return Builtin::Sub;
+    if (name == "*") return Builtin::Mul;
+    if (name == "<") return Builtin::Lt;
+    if (name == ">") return Builtin::Gt;
+    if (name == "=") return Builtin::Eq;
+    return std::nullopt;
+}
+
+std::string to_string(const Expr& expr) { return std::visit(Printer{}, expr); }
+
+std::string to_string(const Stmt& stmt) { return std::visit(Printer{}, stmt); }
@@ -1,18 +1,32 @@
 #ifndef AST_H_
 #define AST_H_
 
+#include <cstdint>
+#include <optional>
 #include <string>
-#include <utility>
+#include <string_view>
 #include <variant>
-#include <vector>
+
+#include "absl/types/span.h"
+#include "symbols.h"
+
+// AST nodes are allocated in an Arena by the parser and refer to each
+// other through pointers into that arena. They are trivially destructible
+// and are freed all at once with the arena. Names are interned symbols
+// owned by a SymbolTable.
 
 struct BoolExpr;
 struct IntExpr;
+struct NilExpr;
 struct SymbolExpr;
 struct IfExpr;
 struct LetExpr;
+struct BuiltinExpr;
+struct LambdaExpr;
+struct CallExpr;
 
-using Expr = std::variant<BoolExpr, IntExpr, SymbolExpr, IfExpr, LetExpr>;
+using Expr = std::variant<BoolExpr, IntExpr, NilExpr, SymbolExpr, IfExpr,
+                          LetExpr, BuiltinExpr, LambdaExpr, CallExpr>;
 
 struct BoolExpr {
     int line;
@@ -21,28 +35,87 @@ struct BoolExpr {
 
 struct IntExpr {
     int line;
-    int value;
+    int64_t value;
+};
+
+struct NilExpr {
+    int line;
 };
 
 struct SymbolExpr {
     int line;
-    std::string name;
+    Symbol symbol;
 };
 
 struct IfExpr {
     int line;
-    std::unique_ptr<Expr> cond;
-    std::unique_ptr<Expr> conseq;
-    std::unique_ptr<Expr> alt;
+    const Expr* cond;
+    const Expr* conseq;
+    const Expr* alt;
+};
+
+struct Binding {
+    Symbol name;
+    const Expr* value;
 };
 
 struct LetExpr {
     int line;
-    std::vector<std::pair<std::string, Expr>> bindings;
-    std::unique_ptr<Expr> body;
+    absl::Span<const Binding> bindings;
+    const Expr* body;
+};
+
+// Primitive operations, which are called like functions but compile
+// directly to instructions.
+enum class Builtin {
+    Cons,
+    Car,
+    Cdr,
+    IsNil,
+    Add,
+    Sub,
+    Mul,
+    Lt,
+    Gt,
+    Eq,
+};
+
+std::string to_string(Builtin op);
+// number of arguments |op| takes
+int arity(Builtin op);
+// the builtin called |name|, if there is one
+std::optional<Builtin> lookup_builtin(std::string_view name);
+
+struct BuiltinExpr {
+    int line;
+    Builtin op;
+    absl::Span<const Expr* const> args;
+};
+
+struct LambdaExpr {
+    int line;
+    absl::Span<const Symbol> params;
+    const Expr* body;
+};
+
+struct CallExpr {
+    int line;
+    const Expr* fn;
+    absl::Span<const Expr* const> args;
+};
+
+// binds |name| to the value of |value| at global scope, where it is
+// visible to all later statements
+struct DefineStmt {
+    int line;
+    Symbol name;
+    const Expr* value;
+    // (define-memo (f ...) body) caches the results of calls to the
+    // function, whose value is a LambdaExpr
+    bool memo = false;
 };
 
-using Stmt = std::variant<Expr>;
+using Stmt = std::variant<Expr, DefineStmt>;
 
 std::string to_string(const Expr& expr);
 std::string to_string(const Stmt& stmt);
@@ -0,0 +1,161 @@
+#include "bignum.h"
+
+#include <algorithm>
+
+namespace {
+
+using Digits = std::vector<uint32_t>;
+
+int compare_magnitudes(const Digits& a, const Digits& b) {
+    if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+    for (int i = a.size() - 1; i >= 0; i--) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+Digits add_magnitudes(const Digits& a, const Digits& b) {
+    const Digits& longer = a.size() >= b.size() ? a : b;
+    const Digits& shorter = a.size() >= b.size() ? b : a;
+    Digits sum;
+    sum.reserve(longer.size() + 1);
+    uint64_t carry = 0;
+    for (int i = 0; i < longer.size(); i++) {
+        carry += longer[i];
+        if (i < shorter.size()) carry += shorter[i];
+        sum.push_back(static_cast<uint32_t>(carry));
+        carry >>= 32;
+    }
+    if (carry != 0) sum.push_back(static_cast<uint32_t>(carry));
+    return sum;
+}
+
+// |a| - |b|, where |a| >= |b|
+Digits subtract_magnitudes(const Digits& a, const Digits& b) {
+    Digits difference;
+    difference.reserve(a.size());
+    int64_t borrow = 0;
+    for (int i = 0; i < a.size(); i++) {
+        int64_t d = static_cast<int64_t>(a[i]) - borrow;
+        if (i < b.size()) d -= b[i];
+        borrow = d < 0;
+        if (d < 0) d += int64_t{1} << 32;
+        difference.push_back(static_cast<uint32_t>(d));
+    }
+    return difference;
+}
+
+// divides |digits| in place by |divisor| and returns the remainder
+uint32_t divide(Digits* digits, uint32_t divisor) {
+    uint64_t remainder = 0;
+    for (int i = digits->size() - 1; i >= 0; i--) {
+        uint64_t n = (remainder << 32) | (*digits)[i];
+        (*digits)[i] = static_cast<uint32_t>(n / divisor);
+        remainder = n % divisor;
+    }
+    while (!digits->empty() && digits->back() == 0) digits->pop_back();
+    return static_cast<uint32_t>(remainder);
+}
+
+}  // namespace
+
+Bignum::Bignum(int64_t value) : negative_(value < 0) {
+    // negate as unsigned so that the most negative value doesn't overflow
+    uint64_t magnitude = static_cast<uint64_t>(value);
+    if (negative_) magnitude = 0 - magnitude;
+    while (magnitude != 0) {
+        digits_.push_back(static_cast<uint32_t>(magnitude));
+        magnitude >>= 32;
+    }
+}
+
+Bignum::Bignum(bool negative, absl::Span<const uint32_t> digits)
+    : negative_(negative), digits_(digits.begin(), digits.end()) {
+    normalize();
+}
+
+void Bignum::normalize() {
+    while (!digits_.empty() && digits_.back() == 0) digits_.pop_back();
+    if (digits_.empty()) negative_ = false;
+}
+
+std::optional<int64_t> Bignum::to_int64() const {
+    if (digits_.size() > 2) return std::nullopt;
+    uint64_t magnitude = 0;
+    for (int i = digits_.size() - 1; i >= 0; i--) {
+        magnitude = (magnitude << 32) | digits_[i];
+    }
+    constexpr uint64_t kMax = INT64_MAX;
+    if (negative_) {
+        if (magnitude > kMax + 1) return std::nullopt;
+        return static_cast<int64_t>(0 - magnitude);
+    }
+    if (magnitude > kMax) return std::nullopt;
+    return static_cast<int64_t>(magnitude);
+}
+
+std::string Bignum::str() const {
+    if (digits_.empty()) return "0";
+    // peel off nine decimal digits at a time, least significant first
+    constexpr uint32_t kChunk = 1000000000;
+    Digits rest = digits_;
+    std::string s;
+    while (!rest.empty()) {
+        uint32_t chunk = divide(&rest, kChunk);
+        for (int i = 0; i < 9 && (!rest.empty() || chunk != 0); i++) {
+            s.push_back('0' + chunk % 10);
+            chunk /= 10;
+        }
+    }
+    if (negative_) s.push_back('-');
+    std::reverse(s.begin(), s.end());
+    return s;
+}
+
+Bignum operator+(const Bignum& a, const Bignum& b) {
+    Bignum sum;
+    if (a.negative_ == b.negative_) {
+        sum.negative_ = a.negative_;
+        sum.digits_ = add_magnitudes(a.digits_, b.digits_);
+    } else if (compare_magnitudes(a.digits_, b.digits_) >= 0) {
+        sum.negative_ = a.negative_;
+        sum.digits_ = subtract_magnitudes(a.digits_, b.digits_);
+    } else {
+        sum.negative_ = b.negative_;
+        sum.digits_ = subtract_magnitudes(b.digits_, a.digits_);
+    }
+    sum.normalize();
+    return sum;
+}
+
+Bignum operator-(const Bignum& a, const Bignum& b) {
+    Bignum negated = b;
+    negated.negative_ = !b.negative_;
+    negated.normalize();
+    return a + negated;
+}
+
+Bignum operator*(const Bignum& a, const Bignum& b) {
+    Bignum product;
+    if (a.digits_.empty() || b.digits_.empty()) return product;
+    product.negative_ = a.negative_ != b.negative_;
+    product.digits_.assign(a.digits_.size() + b.digits_.size(), 0);
+    for (int i = 0; i < a.digits_.size(); i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < b.digits_.size(); j++) {
+            uint64_t t = static_cast<uint64_t>(a.digits_[i]) * b.digits_[j] +
+                         product.digits_[i + j] + carry;
+            product.digits_[i + j] = static_cast<uint32_t>(t);
+            carry = t >> 32;
+        }
+        product.digits_[i + b.digits_.size()] = static_cast<uint32_t>(carry);
+    }
+    product.normalize();
+    return product;
+}
+
+int compare(const Bignum& a, const Bignum& b) {
+    if (a.negative_ != b.negative_) return a.negative_ ? -1 : 1;
+    int c = compare_magnitudes(a.digits_, b.digits_);
+    return a.negative_ ? -c : c;
+}
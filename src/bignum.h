@@ -0,0 +1,47 @@
+#ifndef BIGNUM_H_
+#define BIGNUM_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+
+// Arbitrary-precision integers, for values that don't fit in a fixnum. A
+// Bignum is a sign and a magnitude in base 2^32, least significant digit
+// first and without leading zero digits, so zero has no digits at all.
+//
+// These are only used on the slow paths: the vm works on fixnums directly
+// and converts to Bignums when an operand is a bignum or a result
+// overflows.
+class Bignum final {
+public:
+    Bignum() = default;
+    explicit Bignum(int64_t value);
+    Bignum(bool negative, absl::Span<const uint32_t> digits);
+
+    bool negative() const { return negative_; }
+    absl::Span<const uint32_t> digits() const { return digits_; }
+
+    // the value as a fixnum, if it fits in one
+    std::optional<int64_t> to_int64() const;
+    // the value in decimal
+    std::string str() const;
+
+    friend Bignum operator+(const Bignum& a, const Bignum& b);
+    friend Bignum operator-(const Bignum& a, const Bignum& b);
+    friend Bignum operator*(const Bignum& a, const Bignum& b);
+    // negative, zero or positive as |a| is less than, equal to or greater
+    // than |b|
+    friend int compare(const Bignum& a, const Bignum& b);
+
+private:
+    // drops leading zero digits and the sign of zero
+    void normalize();
+
+    bool negative_ = false;
+    std::vector<uint32_t> digits_;
+};
+
+#endif  // BIGNUM_H_
@@ -0,0 +1,866 @@
+#include "cgen.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_format.h"
+#include "instr.h"
+#include "program.h"
+#include "value.h"
+
+namespace {
+
+// The runtime every generated program starts with. It mirrors value.h,
+// heap.cc, bignum.cc and the checks in vm.cc, and the generated code
+// calls into it through the J_ macros below, one per opcode. The macros
+// work on the locals that J_START declares, like the handlers in vm.cc.
+constexpr char kRuntime[] = R"runtime(
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__)
+#define J_NORETURN __attribute__((noreturn))
+#else
+#define J_NORETURN
+#endif
+
+enum {
+    J_UNDEFINED = 0,
+    J_BOOL = 1,
+    J_INT = 2,
+    J_NIL = 3,
+    J_PAIR = 4,
+    J_CLOSURE = 5,
+    J_BIGINT = 6,
+};
+
+struct j_object;
+
+typedef struct {
+    int typ;
+    union {
+        bool b;
+        int64_t i;
+        struct j_object* obj;
+    } as;
+} j_value;
+
+typedef struct j_object {
+    int typ;
+    uint32_t size;
+    struct j_object* forwarded;
+} j_object;
+
+typedef struct {
+    j_object o;
+    j_value car;
+    j_value cdr;
+} j_pair;
+
+typedef struct {
+    j_object o;
+    int entry;
+    int arity;
+    int num_captures;
+    j_value captures[];
+} j_closure;
+
+typedef struct {
+    j_object o;
+    bool negative;
+    int num_digits;
+    uint32_t digits[];
+} j_bigint;
+
+typedef struct {
+    int pc;
+    int fp;
+} j_frame;
+
+#define J_MAX_FRAMES (1 << 20)
+
+/* values live in j_stack[0, j_sp), but the generated code keeps its own
+   stack pointer and only stores it here before allocating */
+static j_value* j_stack;
+static int j_stack_size;
+static int j_sp;
+static j_value* j_globals;
+static int j_num_globals;
+static j_frame* j_frames;
+static int j_frames_size;
+static int j_num_frames;
+static char* j_space;
+static char* j_next;
+static char* j_end;
+static size_t j_capacity;
+
+/* errors */
+
+static J_NORETURN void j_fail(int pc, const char* message) {
+    fflush(stdout);
+    fprintf(stderr, "[pc=%d] vm: %s\n", pc, message);
+    exit(EXIT_FAILURE);
+}
+
+static J_NORETURN void j_out_of_memory(void) {
+    fflush(stdout);
+    fputs("out of memory\n", stderr);
+    exit(EXIT_FAILURE);
+}
+
+static const char* j_type_name(int typ) {
+    switch (typ) {
+        case J_BOOL: return "Bool";
+        case J_INT: return "Int";
+        case J_NIL: return "Nil";
+        case J_PAIR: return "Pair";
+        case J_CLOSURE: return "Closure";
+        default: return "BigInt";
+    }
+}
+
+static J_NORETURN void j_type_error(int pc, int want, int got) {
+    char message[64];
+    snprintf(message, sizeof(message), "type error: want %s, got %s",
+             j_type_name(want), j_type_name(got));
+    j_fail(pc, message);
+}
+
+static bool j_is_integer(int typ) { return typ == J_INT || typ == J_BIGINT; }
+
+static void j_check_integers(int pc, j_value a, j_value b) {
+    if (!j_is_integer(a.typ)) j_type_error(pc, J_INT, a.typ);
+    if (!j_is_integer(b.typ)) j_type_error(pc, J_INT, b.typ);
+}
+
+/* the stack and frames */
+
+static void* j_grow(void* p, size_t n, size_t size) {
+    p = realloc(p, n * size);
+    if (p == NULL) j_out_of_memory();
+    return p;
+}
+
+static void j_reserve(int sp, int n) {
+    if (sp + n <= j_stack_size) return;
+    int size = 2 * j_stack_size;
+    if (size < sp + n) size = sp + n;
+    j_stack = j_grow(j_stack, size, sizeof(j_value));
+    j_stack_size = size;
+}
+
+static void j_push_frame(int pc, int ret, int fp) {
+    if (j_num_frames == j_frames_size) {
+        if (j_num_frames == J_MAX_FRAMES) j_fail(pc, "stack overflow");
+        j_frames_size = 2 * j_frames_size;
+        if (j_frames_size > J_MAX_FRAMES) j_frames_size = J_MAX_FRAMES;
+        j_frames = j_grow(j_frames, j_frames_size, sizeof(j_frame));
+    }
+    j_frames[j_num_frames].pc = ret;
+    j_frames[j_num_frames].fp = fp;
+    j_num_frames++;
+}
+
+/* returns the closure |callee|, which is being called with |argc|
+   arguments */
+static j_closure* j_callee(int pc, j_value callee, int argc) {
+    if (callee.typ != J_CLOSURE) j_type_error(pc, J_CLOSURE, callee.typ);
+    j_closure* closure = (j_closure*)callee.as.obj;
+    if (closure->arity != argc) {
+        char message[80];
+        snprintf(message, sizeof(message),
+                 "wrong number of arguments: want %d, got %d",
+                 closure->arity, argc);
+        j_fail(pc, message);
+    }
+    return closure;
+}
+
+/* the heap: a semispace copying collector whose roots are the stack below
+   j_sp and the globals */
+
+#define J_ALIGN(size) (((size) + 15) & ~(size_t)15)
+
+static void j_evacuate(j_value* value, char** next) {
+    if (value->typ != J_PAIR && value->typ != J_CLOSURE &&
+        value->typ != J_BIGINT) {
+        return;
+    }
+    j_object* obj = value->as.obj;
+    if (obj->forwarded == NULL) {
+        memcpy(*next, obj, obj->size);
+        obj->forwarded = (j_object*)*next;
+        *next += obj->size;
+    }
+    value->as.obj = obj->forwarded;
+}
+
+static void j_copy(size_t capacity) {
+    char* to = malloc(capacity);
+    if (to == NULL) j_out_of_memory();
+    char* next = to;
+    for (int i = 0; i < j_sp; i++) j_evacuate(&j_stack[i], &next);
+    for (int i = 0; i < j_num_globals; i++) j_evacuate(&j_globals[i], &next);
+    for (char* scan = to; scan < next;) {
+        j_object* obj = (j_object*)scan;
+        if (obj->typ == J_PAIR) {
+            j_evacuate(&((j_pair*)obj)->car, &next);
+            j_evacuate(&((j_pair*)obj)->cdr, &next);
+        } else if (obj->typ == J_CLOSURE) {
+            j_closure* closure = (j_closure*)obj;
+            for (int i = 0; i < closure->num_captures; i++) {
+                j_evacuate(&closure->captures[i], &next);
+            }
+        }
+        scan += obj->size;
+    }
+    free(j_space);
+    j_space = to;
+    j_next = next;
+    j_end = to + capacity;
+    j_capacity = capacity;
+}
+
+static void j_collect(size_t size) {
+    j_copy(j_capacity);
+    /* keep the heap at most half full */
+    size_t want = 2 * ((size_t)(j_next - j_space) + size);
+    if (want > j_capacity) {
+        j_copy(want > 2 * j_capacity ? want : 2 * j_capacity);
+    }
+}
+
+/* j_sp must be up to date, since this can collect */
+static j_object* j_allocate(int typ, size_t size) {
+    size = J_ALIGN(size);
+    if ((size_t)(j_end - j_next) < size) j_collect(size);
+    j_object* obj = (j_object*)j_next;
+    j_next += size;
+    obj->typ = typ;
+    obj->size = (uint32_t)size;
+    obj->forwarded = NULL;
+    return obj;
+}
+
+/* integers: the slow paths for bignums and overflow. A magnitude is base
+   2^32, least significant digit first, without leading zeros. */
+
+typedef struct {
+    bool negative;
+    int n;
+    const uint32_t* digits;
+} j_big;
+
+/* |tmp| holds the digits of a fixnum */
+static j_big j_to_big(j_value v, uint32_t tmp[2]) {
+    j_big big;
+    if (v.typ == J_INT) {
+        uint64_t magnitude = (uint64_t)v.as.i;
+        big.negative = v.as.i < 0;
+        if (big.negative) magnitude = 0 - magnitude;
+        tmp[0] = (uint32_t)magnitude;
+        tmp[1] = (uint32_t)(magnitude >> 32);
+        big.n = tmp[1] != 0 ? 2 : tmp[0] != 0 ? 1 : 0;
+        big.digits = tmp;
+    } else {
+        j_bigint* obj = (j_bigint*)v.as.obj;
+        big.negative = obj->negative;
+        big.n = obj->num_digits;
+        big.digits = obj->digits;
+    }
+    return big;
+}
+
+static int j_compare_magnitudes(j_big a, j_big b) {
+    if (a.n != b.n) return a.n < b.n ? -1 : 1;
+    for (int i = a.n - 1; i >= 0; i--) {
+        if (a.digits[i] != b.digits[i]) {
+            return a.digits[i] < b.digits[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static int j_add_magnitudes(j_big a, j_big b, uint32_t* sum) {
+    int n = a.n > b.n ? a.n : b.n;
+    uint64_t carry = 0;
+    for (int i = 0; i < n; i++) {
+        if (i < a.n) carry += a.digits[i];
+        if (i < b.n) carry += b.digits[i];
+        sum[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    sum[n] = (uint32_t)carry;
+    return n + 1;
+}
+
+/* |a| - |b|, where |a| >= |b| */
+static int j_subtract_magnitudes(j_big a, j_big b, uint32_t* difference) {
+    int64_t borrow = 0;
+    for (int i = 0; i < a.n; i++) {
+        int64_t d = (int64_t)a.digits[i] - borrow;
+        if (i < b.n) d -= b.digits[i];
+        borrow = d < 0;
+        if (d < 0) d += (int64_t)1 << 32;
+        difference[i] = (uint32_t)d;
+    }
+    return a.n;
+}
+
+static int j_multiply_magnitudes(j_big a, j_big b, uint32_t* product) {
+    memset(product, 0, (a.n + b.n) * sizeof(uint32_t));
+    for (int i = 0; i < a.n; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < b.n; j++) {
+            uint64_t t = (uint64_t)a.digits[i] * b.digits[j] +
+                         product[i + j] + carry;
+            product[i + j] = (uint32_t)t;
+            carry = t >> 32;
+        }
+        product[i + b.n] = (uint32_t)carry;
+    }
+    return a.n + b.n;
+}
+
+/* the integer as a fixnum if it fits, otherwise as a new bigint */
+static j_value j_make_integer(bool negative, const uint32_t* digits, int n) {
+    while (n > 0 && digits[n - 1] == 0) n--;
+    j_value v;
+    if (n <= 2) {
+        uint64_t magnitude = 0;
+        for (int i = n - 1; i >= 0; i--) {
+            magnitude = (magnitude << 32) | digits[i];
+        }
+        if (!negative && magnitude <= INT64_MAX) {
+            v.typ = J_INT;
+            v.as.i = (int64_t)magnitude;
+            return v;
+        }
+        if (negative && magnitude <= (uint64_t)INT64_MAX + 1) {
+            v.typ = J_INT;
+            v.as.i = (int64_t)(0 - magnitude);
+            return v;
+        }
+    }
+    j_bigint* big = (j_bigint*)j_allocate(
+        J_BIGINT, sizeof(j_bigint) + n * sizeof(uint32_t));
+    big->negative = negative;
+    big->num_digits = n;
+    memcpy(big->digits, digits, n * sizeof(uint32_t));
+    v.typ = J_BIGINT;
+    v.as.obj = &big->o;
+    return v;
+}
+
+/* |op| is one of + - *; j_sp must be up to date */
+static j_value j_arithmetic(char op, j_value a, j_value b) {
+    uint32_t ta[2], tb[2];
+    j_big x = j_to_big(a, ta), y = j_to_big(b, tb);
+    if (op == '-') y.negative = !y.negative && y.n > 0;
+    uint32_t* digits = malloc((x.n + y.n + 1) * sizeof(uint32_t));
+    if (digits == NULL) j_out_of_memory();
+    bool negative;
+    int n;
+    if (op == '*') {
+        negative = x.negative != y.negative;
+        n = j_multiply_magnitudes(x, y, digits);
+    } else if (x.negative == y.negative) {
+        negative = x.negative;
+        n = j_add_magnitudes(x, y, digits);
+    } else if (j_compare_magnitudes(x, y) >= 0) {
+        negative = x.negative;
+        n = j_subtract_magnitudes(x, y, digits);
+    } else {
+        negative = y.negative;
+        n = j_subtract_magnitudes(y, x, digits);
+    }
+    j_value result = j_make_integer(negative, digits, n);
+    free(digits);
+    return result;
+}
+
+static int j_compare(j_value a, j_value b) {
+    uint32_t ta[2], tb[2];
+    j_big x = j_to_big(a, ta), y = j_to_big(b, tb);
+    if (x.negative != y.negative) return x.negative ? -1 : 1;
+    int c = j_compare_magnitudes(x, y);
+    return x.negative ? -c : c;
+}
+
+/* printing */
+
+static void j_print_bigint(const j_bigint* big) {
+    /* peel off nine decimal digits at a time, least significant first */
+    int n = big->num_digits;
+    uint32_t* rest = malloc(n * sizeof(uint32_t));
+    uint32_t* chunks = malloc((2 * n + 1) * sizeof(uint32_t));
+    if (rest == NULL || chunks == NULL) j_out_of_memory();
+    memcpy(rest, big->digits, n * sizeof(uint32_t));
+    int num_chunks = 0;
+    while (n > 0) {
+        uint64_t remainder = 0;
+        for (int i = n - 1; i >= 0; i--) {
+            uint64_t x = (remainder << 32) | rest[i];
+            rest[i] = (uint32_t)(x / 1000000000);
+            remainder = x % 1000000000;
+        }
+        while (n > 0 && rest[n - 1] == 0) n--;
+        chunks[num_chunks++] = (uint32_t)remainder;
+    }
+    if (big->negative) putchar('-');
+    printf("%" PRIu32, chunks[num_chunks - 1]);
+    for (int i = num_chunks - 2; i >= 0; i--) printf("%09" PRIu32, chunks[i]);
+    free(rest);
+    free(chunks);
+}
+
+static void j_print_value(j_value v) {
+    switch (v.typ) {
+        case J_BOOL: fputs(v.as.b ? "true" : "false", stdout); break;
+        case J_INT: printf("%" PRId64, v.as.i); break;
+        case J_NIL: fputs("nil", stdout); break;
+        case J_CLOSURE: fputs("<function>", stdout); break;
+        case J_BIGINT: j_print_bigint((j_bigint*)v.as.obj); break;
+        case J_PAIR: {
+            /* (1 2 3), or (1 2 . 3) for an improper list */
+            j_pair* pair = (j_pair*)v.as.obj;
+            putchar('(');
+            j_print_value(pair->car);
+            j_value rest = pair->cdr;
+            while (rest.typ == J_PAIR) {
+                pair = (j_pair*)rest.as.obj;
+                putchar(' ');
+                j_print_value(pair->car);
+                rest = pair->cdr;
+            }
+            if (rest.typ != J_NIL) {
+                fputs(" . ", stdout);
+                j_print_value(rest);
+            }
+            putchar(')');
+            break;
+        }
+    }
+}
+
+static void j_init(int num_globals) {
+    j_stack_size = 1024;
+    j_stack = j_grow(NULL, j_stack_size, sizeof(j_value));
+    j_frames_size = 64;
+    j_frames = j_grow(NULL, j_frames_size, sizeof(j_frame));
+    j_num_globals = num_globals;
+    j_globals = calloc(num_globals + 1, sizeof(j_value));
+    j_capacity = 256 << 10;
+    j_space = malloc(j_capacity);
+    if (j_globals == NULL || j_space == NULL) j_out_of_memory();
+    j_next = j_space;
+    j_end = j_space + j_capacity;
+}
+
+/* the instructions, each given the index |at| of the instruction for its
+   error messages */
+
+#define J_START(num_globals)                  \
+    j_init(num_globals);                      \
+    j_value* base = j_stack;                  \
+    j_value* sp = base;                       \
+    j_value* limit = base + j_stack_size;     \
+    int fp = 0;                               \
+    int pc = 0;                               \
+    (void)limit;                              \
+    (void)fp
+
+#define J_RESERVE(n)                                  \
+    if (limit - sp < (n)) {                           \
+        int depth = (int)(sp - base);                 \
+        j_reserve(depth, (n));                        \
+        base = j_stack;                               \
+        sp = base + depth;                            \
+        limit = base + j_stack_size;                  \
+    }
+#define J_SYNC() j_sp = (int)(sp - base)
+#define J_NEED(at, n) \
+    if (sp - base < (n)) j_fail((at), "stack underflow")
+#define J_BAD_OFFSET(at) j_fail((at), "stack offset out of bounds")
+
+#define J_PUSH(at, k) \
+    do {              \
+        J_RESERVE(1); \
+        *sp++ = K[k]; \
+    } while (0)
+#define J_POP(at)      \
+    do {               \
+        J_NEED(at, 1); \
+        --sp;          \
+    } while (0)
+#define J_PRINT(at)               \
+    do {                          \
+        J_NEED(at, 1);            \
+        j_print_value(sp[-1]);    \
+        putchar('\n');            \
+    } while (0)
+#define J_JMP_IF_NOT(at, target)                                       \
+    do {                                                               \
+        J_NEED(at, 1);                                                 \
+        --sp;                                                          \
+        if (sp->typ != J_BOOL) j_type_error((at), J_BOOL, sp->typ);    \
+        if (!sp->as.b) goto target;                                    \
+    } while (0)
+#define J_SWAP(at)             \
+    do {                       \
+        J_NEED(at, 2);         \
+        j_value top = sp[-1];  \
+        sp[-1] = sp[-2];       \
+        sp[-2] = top;          \
+    } while (0)
+#define J_GET(at, n)                                                   \
+    do {                                                               \
+        if ((n) < 0 || fp + (n) >= sp - base) J_BAD_OFFSET(at);        \
+        J_RESERVE(1);                                                  \
+        *sp = base[fp + (n)];                                          \
+        sp++;                                                          \
+    } while (0)
+#define J_SLIDE(at, n)                                                 \
+    do {                                                               \
+        if ((n) < 0 || (n) >= sp - base) j_fail((at), "stack underflow"); \
+        sp[-(n)-1] = sp[-1];                                           \
+        sp -= (n);                                                     \
+    } while (0)
+#define J_GET2(at, n, m)                                               \
+    do {                                                               \
+        int locals = (int)(sp - base) - fp;                            \
+        if ((n) < 0 || (n) >= locals || (m) < 0 || (m) > locals) {     \
+            J_BAD_OFFSET(at);                                          \
+        }                                                              \
+        J_RESERVE(2);                                                  \
+        sp[0] = base[fp + (n)];                                        \
+        sp[1] = base[fp + (m)];                                        \
+        sp += 2;                                                       \
+    } while (0)
+#define J_GET_GLOBAL(at, slot, name)                                   \
+    do {                                                               \
+        if (j_globals[slot].typ == J_UNDEFINED) {                      \
+            j_fail((at), "global " name " is not defined");            \
+        }                                                              \
+        J_RESERVE(1);                                                  \
+        *sp++ = j_globals[slot];                                       \
+    } while (0)
+#define J_SET_GLOBAL(at, slot)      \
+    do {                            \
+        J_NEED(at, 1);              \
+        j_globals[slot] = *--sp;    \
+    } while (0)
+#define J_CONS(at)                                                     \
+    do {                                                               \
+        J_NEED(at, 2);                                                 \
+        /* the operands are still on the stack, so they survive */     \
+        J_SYNC();                                                      \
+        j_pair* pair = (j_pair*)j_allocate(J_PAIR, sizeof(j_pair));    \
+        pair->car = sp[-2];                                            \
+        pair->cdr = sp[-1];                                            \
+        --sp;                                                          \
+        sp[-1].typ = J_PAIR;                                           \
+        sp[-1].as.obj = &pair->o;                                      \
+    } while (0)
+#define J_CAR_OR_CDR(at, field)                                        \
+    do {                                                               \
+        J_NEED(at, 1);                                                 \
+        if (sp[-1].typ != J_PAIR) j_type_error((at), J_PAIR, sp[-1].typ); \
+        sp[-1] = ((j_pair*)sp[-1].as.obj)->field;                      \
+    } while (0)
+#define J_CAR(at) J_CAR_OR_CDR(at, car)
+#define J_CDR(at) J_CAR_OR_CDR(at, cdr)
+#define J_IS_NIL(at)                            \
+    do {                                        \
+        J_NEED(at, 1);                          \
+        bool nil = sp[-1].typ == J_NIL;         \
+        sp[-1].typ = J_BOOL;                    \
+        sp[-1].as.b = nil;                      \
+    } while (0)
+#define J_MAKE_CLOSURE(at, entry_, arity_, count)                      \
+    do {                                                               \
+        J_NEED(at, count);                                             \
+        J_SYNC();                                                      \
+        j_closure* closure = (j_closure*)j_allocate(                   \
+            J_CLOSURE, sizeof(j_closure) + (count) * sizeof(j_value)); \
+        closure->entry = (entry_);                                     \
+        closure->arity = (arity_);                                     \
+        closure->num_captures = (count);                               \
+        memcpy(closure->captures, sp - (count),                        \
+               (count) * sizeof(j_value));                             \
+        sp -= (count);                                                 \
+        J_RESERVE(1);                                                  \
+        sp->typ = J_CLOSURE;                                           \
+        sp->as.obj = &closure->o;                                      \
+        sp++;                                                          \
+    } while (0)
+#define J_GET_CAPTURE(at, n)                                           \
+    do {                                                               \
+        if (fp == 0 || base[fp - 1].typ != J_CLOSURE) J_BAD_OFFSET(at); \
+        j_closure* closure = (j_closure*)base[fp - 1].as.obj;          \
+        if ((n) < 0 || (n) >= closure->num_captures) J_BAD_OFFSET(at); \
+        J_RESERVE(1);                                                  \
+        *sp++ = closure->captures[n];                                  \
+    } while (0)
+#define J_CALL(at, argc, ret)                                          \
+    do {                                                               \
+        if ((argc) < 0 || sp - base < (argc) + 1) {                    \
+            j_fail((at), "stack underflow");                           \
+        }                                                              \
+        j_closure* closure = j_callee((at), sp[-(argc)-1], (argc));    \
+        j_push_frame((at), (ret), fp);                                 \
+        fp = (int)(sp - base) - (argc);                                \
+        pc = closure->entry;                                           \
+        goto j_dispatch;                                               \
+    } while (0)
+#define J_TAIL_CALL(at, argc)                                          \
+    do {                                                               \
+        if ((argc) < 0 || sp - base < (argc) + 1 || j_num_frames == 0) { \
+            j_fail((at), "stack underflow");                           \
+        }                                                              \
+        j_closure* closure = j_callee((at), sp[-(argc)-1], (argc));    \
+        /* move the closure and its arguments down over the frame */   \
+        memmove(base + fp - 1, sp - (argc)-1,                          \
+                ((argc) + 1) * sizeof(j_value));                       \
+        sp = base + fp + (argc);                                       \
+        pc = closure->entry;                                           \
+        goto j_dispatch;                                               \
+    } while (0)
+#define J_RET(at)                                                      \
+    do {                                                               \
+        if (j_num_frames == 0 || sp - base <= fp) {                    \
+            j_fail((at), "stack underflow");                           \
+        }                                                              \
+        base[fp - 1] = sp[-1];                                         \
+        sp = base + fp;                                                \
+        j_num_frames--;                                                \
+        pc = j_frames[j_num_frames].pc;                                \
+        fp = j_frames[j_num_frames].fp;                                \
+        goto j_dispatch;                                               \
+    } while (0)
+#define J_FIXNUMS() (sp[-2].typ == J_INT && sp[-1].typ == J_INT)
+#define J_ARITHMETIC(at, op, checked)                                  \
+    do {                                                               \
+        J_NEED(at, 2);                                                 \
+        int64_t result;                                                \
+        if (J_FIXNUMS() && !checked(sp[-2].as.i, sp[-1].as.i, &result)) { \
+            sp[-2].as.i = result;                                      \
+        } else {                                                       \
+            j_check_integers((at), sp[-2], sp[-1]);                    \
+            J_SYNC();                                                  \
+            sp[-2] = j_arithmetic(op, sp[-2], sp[-1]);                 \
+        }                                                              \
+        --sp;                                                          \
+    } while (0)
+#define J_ADD(at) J_ARITHMETIC(at, '+', __builtin_add_overflow)
+#define J_SUB(at) J_ARITHMETIC(at, '-', __builtin_sub_overflow)
+#define J_MUL(at) J_ARITHMETIC(at, '*', __builtin_mul_overflow)
+#define J_COMPARE(at, cmp, result)                                     \
+    J_NEED(at, 2);                                                     \
+    if (J_FIXNUMS()) {                                                 \
+        result = sp[-2].as.i cmp sp[-1].as.i;                          \
+    } else {                                                           \
+        j_check_integers((at), sp[-2], sp[-1]);                        \
+        result = j_compare(sp[-2], sp[-1]) cmp 0;                      \
+    }
+#define J_COMPARISON(at, cmp)          \
+    do {                               \
+        bool result;                   \
+        J_COMPARE(at, cmp, result);    \
+        --sp;                          \
+        sp[-1].typ = J_BOOL;           \
+        sp[-1].as.b = result;          \
+    } while (0)
+#define J_LT(at) J_COMPARISON(at, <)
+#define J_GT(at) J_COMPARISON(at, >)
+#define J_EQ(at) J_COMPARISON(at, ==)
+#define J_JMP_IF_NOT_COMPARISON(at, cmp, target) \
+    do {                                         \
+        bool result;                             \
+        J_COMPARE(at, cmp, result);              \
+        sp -= 2;                                 \
+        if (!result) goto target;                \
+    } while (0)
+#define J_JMP_IF_NOT_LT(at, target) J_JMP_IF_NOT_COMPARISON(at, <, target)
+#define J_JMP_IF_NOT_GT(at, target) J_JMP_IF_NOT_COMPARISON(at, >, target)
+#define J_JMP_IF_NOT_EQ(at, target) J_JMP_IF_NOT_COMPARISON(at, ==, target)
+#define J_HALT() \
+    do {                \
+        fflush(stdout); \
+        return 0;       \
+    } while (0)
+)runtime";
+
+std::string c_constant(TaggedValue value) {
+    switch (value.typ) {
+        case Type::Bool:
+            return absl::StrFormat("{J_BOOL, {.b = %s}}",
+                                   value.as.b ? "true" : "false");
+        case Type::Int:
+            // INT64_MIN has no literal
+            if (value.as.i == INT64_MIN) return "{J_INT, {.i = INT64_MIN}}";
+            return absl::StrFormat("{J_INT, {.i = INT64_C(%d)}}", value.as.i);
+        default: return "{J_NIL, {.i = 0}}";
+    }
+}
+
+// |s| as a C string literal. Everything but the characters that symbols
+// are made of is escaped, which also avoids trigraphs.
+std::string c_string(std::string_view s) {
+    std::string literal = "\"";
+    for (char ch : s) {
+        if (absl::ascii_isalnum(ch) ||
+            std::string_view("+-*/%=<>").find(ch) != std::string_view::npos) {
+            literal += ch;
+        } else {
+            absl::StrAppendFormat(&literal, "\\%03o",
+                                  static_cast<unsigned char>(ch));
+        }
+    }
+    return literal + "\"";
+}
+
+// the macro invocation for |instr| at |pc|, whose jump targets are the
+// labels that translate() puts before each jump target. |global_names|
+// are the names of the global slots, by slot, where the chunk named them.
+std::string translate(const Instr& instr, int pc,
+                      absl::Span<const std::string> global_names) {
+    auto target = [&instr] { return absl::StrFormat("L%d", instr.arg); };
+    switch (instr.op) {
+        case Opcode::Push:
+            return absl::StrFormat("J_PUSH(%d, %d);", pc, instr.arg);
+        case Opcode::Pop: return absl::StrFormat("J_POP(%d);", pc);
+        case Opcode::Print: return absl::StrFormat("J_PRINT(%d);", pc);
+        case Opcode::JmpIfNot:
+            return absl::StrFormat("J_JMP_IF_NOT(%d, %s);", pc, target());
+        case Opcode::Jmp: return absl::StrFormat("goto %s;", target());
+        case Opcode::Swap: return absl::StrFormat("J_SWAP(%d);", pc);
+        case Opcode::Get:
+            return absl::StrFormat("J_GET(%d, %d);", pc, instr.arg);
+        case Opcode::Halt: return "J_HALT();";
+        case Opcode::Slide:
+            return absl::StrFormat("J_SLIDE(%d, %d);", pc, instr.arg);
+        case Opcode::Get2:
+            return absl::StrFormat("J_GET2(%d, %d, %d);", pc, instr.arg,
+                                   instr.arg2);
+        case Opcode::GetGlobal: {
+            // like the vm, fall back to the slot number
+            std::string name = instr.arg < global_names.size()
+                                   ? global_names[instr.arg]
+                                   : "";
+            if (name.empty()) name = absl::StrFormat("%d", instr.arg);
+            return absl::StrFormat("J_GET_GLOBAL(%d, %d, %s);", pc,
+                                   instr.arg, c_string(name));
+        }
+        case Opcode::SetGlobal:
+            return absl::StrFormat("J_SET_GLOBAL(%d, %d);", pc, instr.arg);
+        case Opcode::Cons: return absl::StrFormat("J_CONS(%d);", pc);
+        case Opcode::Car: return absl::StrFormat("J_CAR(%d);", pc);
+        case Opcode::Cdr: return absl::StrFormat("J_CDR(%d);", pc);
+        case Opcode::IsNil: return absl::StrFormat("J_IS_NIL(%d);", pc);
+        case Opcode::MakeClosure:
+            return absl::StrFormat("J_MAKE_CLOSURE(%d, %d, %d, %d);", pc,
+                                   instr.arg, instr.arg2, instr.arg3);
+        case Opcode::GetCapture:
+            return absl::StrFormat("J_GET_CAPTURE(%d, %d);", pc, instr.arg);
+        case Opcode::Call:
+            return absl::StrFormat("J_CALL(%d, %d, %d);", pc, instr.arg,
+                                   pc + 1);
+        case Opcode::Ret: return absl::StrFormat("J_RET(%d);", pc);
+        case Opcode::TailCall:
+            return absl::StrFormat("J_TAIL_CALL(%d, %d);", pc, instr.arg);
+        case Opcode::Add: return absl::StrFormat("J_ADD(%d);", pc);
+        case Opcode::Sub: return absl::StrFormat("J_SUB(%d);", pc);
+        case Opcode::Mul: return absl::StrFormat("J_MUL(%d);", pc);
+        case Opcode::Lt: return absl::StrFormat("J_LT(%d);", pc);
+        case Opcode::Gt: return absl::StrFormat("J_GT(%d);", pc);
+        case Opcode::Eq: return absl::StrFormat("J_EQ(%d);", pc);
+        case Opcode::JmpIfNotLt:
+            return absl::StrFormat("J_JMP_IF_NOT_LT(%d, %s);", pc, target());
+        case Opcode::JmpIfNotGt:
+            return absl::StrFormat("J_JMP_IF_NOT_GT(%d, %s);", pc, target());
+        case Opcode::JmpIfNotEq:
+            return absl::StrFormat("J_JMP_IF_NOT_EQ(%d, %s);", pc, target());
+        // rejected by emit_c, since C++ functions can't be linked in
+        case Opcode::CallNative: return "";
+        // also rejected, since the generated code has no hash tables
+        case Opcode::MemoGet:
+        case Opcode::MemoPut: return "";
+    }
+}
+
+}  // namespace
+
+absl::StatusOr<std::string> emit_c(ChunkView chunk) {
+    auto constants = load_constants(chunk.constants);
+    if (!constants.ok()) return constants.status();
+    auto decoded = decode(chunk.code);
+    if (!decoded.ok()) return decoded.status();
+    std::vector<Instr> code = *std::move(decoded);
+    // like the vm, end with a Halt that jumps past the end land on
+    code.push_back(Instr{.op = Opcode::Halt});
+    const int n = code.size();
+
+    // the same checks the vm makes before running a chunk
+    for (const auto& instr : code) {
+        if (instr.op == Opcode::CallNative) {
+            return absl::UnimplementedError(
+                "native functions can't be called from C");
+        }
+        if (instr.op == Opcode::MemoGet || instr.op == Opcode::MemoPut) {
+            return absl::UnimplementedError(
+                "memoized functions can't be compiled to C");
+        }
+    }
+    auto num_globals = validate(code, constants->size(), nullptr);
+    if (!num_globals.ok()) return num_globals.status();
+    auto globals = load_global_names(chunk.globals, *num_globals);
+    if (!globals.ok()) return globals.status();
+    std::vector<std::string> global_names(globals->first);
+    global_names.insert(global_names.end(), globals->names.begin(),
+                        globals->names.end());
+
+    // Jumps become gotos to labels, while function entries and return
+    // points, which are only known at runtime, are cases of the switch
+    // that calls and returns go through.
+    std::vector<bool> is_label(n), is_case(n);
+    is_case[0] = true;
+    for (int pc = 0; pc < n; pc++) {
+        const Instr& instr = code[pc];
+        if (instr.op == Opcode::MakeClosure) is_case[instr.arg] = true;
+        else if (instr.op == Opcode::Call) is_case[pc + 1] = true;
+        else if (has_target(instr.op)) is_label[instr.arg] = true;
+    }
+
+    std::string out = "/* generated by june --emit_c */\n";
+    out += kRuntime;
+    out += "\nstatic const j_value K[] = {\n";
+    for (const auto& constant : *constants) {
+        absl::StrAppendFormat(&out, "    %s,\n", c_constant(constant));
+    }
+    // C has no empty arrays
+    if (constants->empty()) out += "    {J_NIL, {.i = 0}},\n";
+    out += "};\n\n";
+    out += "int main(void) {\n";
+    absl::StrAppendFormat(&out, "    J_START(%d);\n", *num_globals);
+    out += "j_dispatch:\n";
+    out += "    switch (pc) {\n";
+    for (int pc = 0; pc < n; pc++) {
+        if (is_case[pc]) absl::StrAppendFormat(&out, "    case %d:\n", pc);
+        if (is_label[pc]) absl::StrAppendFormat(&out, "    L%d:\n", pc);
+        absl::StrAppendFormat(&out, "        %s\n",
+                              translate(code[pc], pc, global_names));
+    }
+    out += "    }\n";
+    out += "    abort();\n";
+    out += "}\n";
+    return out;
+}
@@ -0,0 +1,22 @@
+#ifndef CGEN_H_
+#define CGEN_H_
+
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "chunk.h"
+
+// Ahead-of-time compiler from bytecode to C. Translates a chunk into a
+// standalone C program that does what the vm does when it executes the
+// chunk: each instruction becomes a few lines of straight-line C, jumps
+// become gotos, and calls and returns go through a switch on the pc.
+//
+// The program starts with a copy of the runtime, which uses the vm's
+// value representation, collector, bignums, type checks and error
+// messages, so it prints exactly what the vm would. It builds with any C
+// compiler that has the GCC overflow builtins:
+//
+//     cc -O2 out.c -o out
+absl::StatusOr<std::string> emit_c(ChunkView chunk);
+
+#endif  // CGEN_H_
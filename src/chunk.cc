@@ -0,0 +1,130 @@
+#include "chunk.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+#include "absl/strings/str_format.h"
+
+namespace {
+constexpr char kMagic[] = {'J', 'U', 'N', 'E'};
+
+uint32_t checksum(absl::Span<const char> bytes) {
+    uint32_t hash = 2166136261u;
+    for (char ch : bytes) {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+absl::Status invalid(std::string_view message) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("bad bytecode file: %s", message));
+}
+}  // namespace
+
+absl::StatusOr<std::vector<TaggedValue>> load_constants(
+    absl::Span<const char> constants) {
+    std::vector<TaggedValue> pool;
+    int at = 0;
+    while (at < constants.size()) {
+        auto value = Value::deserialize(constants, at);
+        if (!value.ok()) return value.status();
+        pool.push_back((*value)->unboxed());
+        at += (*value)->size();
+    }
+    return pool;
+}
+
+void serialize_global_names(const GlobalNames& globals,
+                            std::vector<char>* buf) {
+    if (globals.names.empty()) return;
+    serialize_int32(globals.first, buf);
+    for (const auto& name : globals.names) {
+        serialize_int32(name.size(), buf);
+        buf->insert(buf->end(), name.begin(), name.end());
+    }
+}
+
+absl::StatusOr<GlobalNames> load_global_names(absl::Span<const char> globals,
+                                              int num_globals) {
+    GlobalNames names;
+    if (globals.empty()) return names;
+    auto first = deserialize_int32(globals, 0);
+    if (!first.ok()) return first.status();
+    if (*first < 0 || *first > num_globals) return invalid("bad global slot");
+    names.first = *first;
+    int at = 4;
+    while (at < globals.size()) {
+        auto size = deserialize_int32(globals, at);
+        if (!size.ok()) return size.status();
+        at += 4;
+        if (*size < 0 || *size > globals.size() - at) {
+            return invalid("truncated global name");
+        }
+        if (names.names.size() == num_globals - *first) {
+            return invalid("too many global names");
+        }
+        names.names.emplace_back(globals.data() + at, *size);
+        at += *size;
+    }
+    return names;
+}
+
+std::vector<char> serialize_chunk(const Chunk& chunk) {
+    std::vector<char> buf(std::begin(kMagic), std::end(kMagic));
+    serialize_int32(kBytecodeVersion, &buf);
+    serialize_int32(chunk.constants.size(), &buf);
+    buf.insert(buf.end(), chunk.constants.begin(), chunk.constants.end());
+    serialize_int32(chunk.code.size(), &buf);
+    buf.insert(buf.end(), chunk.code.begin(), chunk.code.end());
+    serialize_int32(chunk.globals.size(), &buf);
+    buf.insert(buf.end(), chunk.globals.begin(), chunk.globals.end());
+    serialize_int32(checksum(buf), &buf);
+    return buf;
+}
+
+absl::StatusOr<ChunkView> deserialize_chunk(absl::Span<const char> bytes) {
+    if (bytes.size() < sizeof(kMagic) + 5 * 4) return invalid("too short");
+    if (!std::equal(std::begin(kMagic), std::end(kMagic), bytes.begin())) {
+        return invalid("bad magic");
+    }
+    auto body = bytes.first(bytes.size() - 4);
+    auto sum = deserialize_int32(bytes, body.size());
+    if (!sum.ok()) return sum.status();
+    if (static_cast<uint32_t>(*sum) != checksum(body)) {
+        return invalid("checksum mismatch");
+    }
+
+    int at = sizeof(kMagic);
+    auto version = deserialize_int32(body, at);
+    if (!version.ok()) return version.status();
+    if (*version != kBytecodeVersion) {
+        return invalid(absl::StrFormat("unsupported version %d, want %d",
+                                       *version, kBytecodeVersion));
+    }
+    at += 4;
+
+    // reads a length-prefixed section
+    auto section = [&body, &at]() -> absl::StatusOr<absl::Span<const char>> {
+        auto size = deserialize_int32(body, at);
+        if (!size.ok()) return size.status();
+        at += 4;
+        if (*size < 0 || *size > body.size() - at) {
+            return invalid("truncated section");
+        }
+        auto span = body.subspan(at, *size);
+        at += *size;
+        return span;
+    };
+    auto constants = section();
+    if (!constants.ok()) return constants.status();
+    auto code = section();
+    if (!code.ok()) return code.status();
+    auto globals = section();
+    if (!globals.ok()) return globals.status();
+    if (at != body.size()) return invalid("trailing bytes");
+    return ChunkView{
+        .constants = *constants, .code = *code, .globals = *globals};
+}
@@ -0,0 +1,72 @@
+#ifndef CHUNK_H_
+#define CHUNK_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "value.h"
+
+// A read-only view of a chunk in memory owned by someone else, e.g. a
+// mapped bytecode file.
+struct ChunkView {
+    absl::Span<const char> constants;
+    absl::Span<const char> code;
+    absl::Span<const char> globals;
+};
+
+// A unit of compiled code. Literals are stored once in the constant pool
+// and referenced from the code by their index in the pool.
+struct Chunk {
+    // serialized Values, in pool order
+    std::vector<char> constants;
+    // serialized instructions
+    std::vector<char> code;
+    // serialized GlobalNames
+    std::vector<char> globals;
+
+    ChunkView view() const { return ChunkView{constants, code, globals}; }
+};
+
+// The names of the global slots [first, first + names.size()), which the
+// vm reports in errors. A chunk compiled in a batch only names the slots
+// its batch added. Serialized as |first| and then each name, as a length
+// followed by its bytes; an empty section names nothing.
+struct GlobalNames {
+    int first = 0;
+    std::vector<std::string> names;
+};
+
+void serialize_global_names(const GlobalNames& globals, std::vector<char>* buf);
+// Fails if the names go past the |num_globals| slots that the chunk's code
+// uses, as validate() counts them.
+absl::StatusOr<GlobalNames> load_global_names(absl::Span<const char> globals,
+                                              int num_globals);
+
+// materializes the constant pool so that each constant is deserialized once
+// when the chunk is loaded rather than every time it is pushed
+absl::StatusOr<std::vector<TaggedValue>> load_constants(
+    absl::Span<const char> constants);
+
+// Bytecode files have the following layout, with all lengths stored as
+// four little-endian bytes (and integer constants as eight):
+//
+//     magic     "JUNE"
+//     version   kBytecodeVersion
+//     constants length, followed by the serialized constant pool
+//     code      length, followed by the serialized instructions
+//     globals   length, followed by the serialized GlobalNames
+//     checksum  FNV-1a hash of all of the preceding bytes
+//
+// The version must be bumped whenever the encoding of instructions or
+// values changes.
+constexpr int kBytecodeVersion = 4;
+
+std::vector<char> serialize_chunk(const Chunk& chunk);
+
+// validates the header and checksum of a bytecode file and returns a view
+// of its sections, which point into |bytes|
+absl::StatusOr<ChunkView> deserialize_chunk(absl::Span<const char> bytes);
+
+#endif  // CHUNK_H_
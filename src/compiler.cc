@@ -2,101 +2,301 @@
 
 #include "absl/strings/str_format.h"
 
-absl::Status Compiler::operator()(const Stmt& es) {
-    if (auto status = std::visit(*this, es); !status.ok()) return status;
-    if (interactive_) push(Opcode::Print);
-    push(Opcode::Pop);
+absl::Status Compiler::visit(const Expr& e, bool tail) {
+    tail_ = tail;
+    return std::visit(*this, e);
+}
+
+void Compiler::emit(Opcode op, std::initializer_list<int> operands) {
+    serialize_opcode(op, &code_);
+    Instr instr{.op = op};
+    int* args[] = {&instr.arg, &instr.arg2, &instr.arg3};
+    int i = 0;
+    for (int operand : operands) {
+        serialize_int32(operand, &code_);
+        *args[i++] = operand;
+    }
+    function().depth += stack_effect(instr);
+}
+
+void Compiler::push_constant(const Value& value) {
+    std::vector<char> buf;
+    value.serialize(&buf);
+    auto [it, inserted] = constant_index_.try_emplace(
+        std::string(buf.begin(), buf.end()), constant_index_.size());
+    if (inserted) constants_.insert(constants_.end(), buf.begin(), buf.end());
+    emit(Opcode::Push, {it->second});
+}
+
+void Compiler::load(Variable var) {
+    switch (var.kind) {
+        case Variable::Kind::Local: emit(Opcode::Get, {var.index}); break;
+        case Variable::Kind::Capture:
+            emit(Opcode::GetCapture, {var.index});
+            break;
+        case Variable::Kind::Global:
+            emit(Opcode::GetGlobal, {var.index});
+            break;
+    }
+}
+
+std::optional<Compiler::Variable> Compiler::resolve(int level, int id) {
+    auto& fn = functions_[level];
+    for (auto it = fn.scopes.rbegin(); it != fn.scopes.rend(); ++it) {
+        if (auto binding = it->find(id); binding != it->end()) {
+            return Variable{.kind = Variable::Kind::Local,
+                            .index = binding->second};
+        }
+    }
+    for (int i = 0; i < fn.captures.size(); i++) {
+        if (fn.captures[i].id == id) {
+            return Variable{.kind = Variable::Kind::Capture, .index = i};
+        }
+    }
+    if (level == 0) {
+        auto global = globals_.find(id);
+        if (global == globals_.end()) return std::nullopt;
+        return Variable{.kind = Variable::Kind::Global,
+                        .index = global->second};
+    }
+    auto outer = resolve(level - 1, id);
+    if (!outer.has_value() || outer->kind == Variable::Kind::Global) {
+        return outer;
+    }
+    fn.captures.push_back(Capture{.id = id, .source = *outer});
+    return Variable{.kind = Variable::Kind::Capture,
+                    .index = static_cast<int>(fn.captures.size()) - 1};
+}
+
+absl::Status Compiler::operator()(const Stmt& s) {
+    if (const auto* def = std::get_if<DefineStmt>(&s)) return (*this)(*def);
+    const auto& e = std::get<Expr>(s);
+    if (auto status = visit(e); !status.ok()) return status;
+    if (interactive_) emit(Opcode::Print);
+    emit(Opcode::Pop);
+    return absl::OkStatus();
+}
+
+absl::Status Compiler::operator()(const DefineStmt& s) {
+    // a function can refer to itself, but other values can't
+    auto slot = [this, &s]() {
+        auto [it, added] = globals_.try_emplace(s.name.id, globals_.size());
+        if (added) global_names_.emplace_back(s.name.name);
+        return it->second;
+    };
+    bool recursive = std::holds_alternative<LambdaExpr>(*s.value);
+    if (recursive) slot();
+    if (s.memo) {
+        const auto* fn = std::get_if<LambdaExpr>(s.value);
+        if (fn == nullptr) {
+            return absl::InvalidArgumentError(absl::StrFormat(
+                "[line %d] compiler: define-memo needs a function", s.line));
+        }
+        if (auto status = lambda(*fn, num_memo_tables_++); !status.ok()) {
+            return status;
+        }
+    } else if (auto status = visit(*s.value); !status.ok()) {
+        return status;
+    }
+    emit(Opcode::SetGlobal, {slot()});
     return absl::OkStatus();
 }
 
 absl::Status Compiler::operator()(const BoolExpr& lit) {
-    push(Opcode::Push);
-    push(BoolValue(lit.value));
+    push_constant(BoolValue(lit.value));
     return absl::OkStatus();
 }
 
 absl::Status Compiler::operator()(const IntExpr& lit) {
-    push(Opcode::Push);
-    push(IntValue(lit.value));
+    push_constant(IntValue(lit.value));
+    return absl::OkStatus();
+}
+
+absl::Status Compiler::operator()(const NilExpr& lit) {
+    push_constant(NilValue());
     return absl::OkStatus();
 }
 
 absl::Status Compiler::operator()(const SymbolExpr& sym) {
-    // find stack distance to binding
-    const auto& name = sym.name;
-    int dist = 0;
-    bool found = false;
-    for (auto it = scopes_.rbegin(); it != scopes_.rend(); ++it) {
-        const auto& scope = *it;
-        if (auto binding_it = scope.find(name); binding_it != scope.end()) {
-            int offset_in_scope = scope.size() - binding_it->second - 1;
-            dist += offset_in_scope;
-            found = true;
-            break;
-        }
-        dist += scope.size();
-    }
-    if (!found) {
+    auto var = resolve(functions_.size() - 1, sym.symbol.id);
+    if (!var.has_value() && natives_ != nullptr &&
+        natives_->lookup(sym.symbol.name).has_value()) {
         return absl::InvalidArgumentError(absl::StrFormat(
-            "[line %d] compiler: %s is not defined", sym.line, name));
+            "[line %d] compiler: native function %s can only be called",
+            sym.line, sym.symbol.name));
+    }
+    if (!var.has_value()) {
+        return absl::InvalidArgumentError(
+            absl::StrFormat("[line %d] compiler: %s is not defined", sym.line,
+                            sym.symbol.name));
     }
-    push(Opcode::Get);
-    IntValue(dist).serialize_value(&code_);
+    load(*var);
     return absl::OkStatus();
 }
 
 absl::Status Compiler::operator()(const IfExpr& e) {
+    const bool tail = tail_;
     // evaluate the condition and jump to the alternate if false
-    if (auto status = std::visit(*this, *e.cond); !status.ok()) return status;
-    push(Opcode::JmpIfNot);
-    auto target1 = code_.size();
+    if (auto status = visit(*e.cond); !status.ok()) return status;
+    auto target1 = code_.size() + 1;
     // fill this in after we know there the alternate starts
-    IntValue(0).serialize_value(&code_);
+    emit(Opcode::JmpIfNot, {0});
+    const int depth = function().depth;
 
     // evaluate the consequent and jump over the alternate
-    if (auto status = std::visit(*this, *e.conseq); !status.ok()) return status;
-    push(Opcode::Jmp);
-    auto target2 = code_.size();
+    if (auto status = visit(*e.conseq, tail); !status.ok()) return status;
+    auto target2 = code_.size() + 1;
     // fill this in after we know there the alternate starts
-    IntValue(0).serialize_value(&code_);
+    emit(Opcode::Jmp, {0});
 
     // evaluate the alternate and fall through
     auto dest1 = code_.size();
-    if (auto status = std::visit(*this, *e.alt); !status.ok()) return status;
+    function().depth = depth;
+    if (auto status = visit(*e.alt, tail); !status.ok()) return status;
     auto dest2 = code_.size();
 
     // update the jump destinations
-    IntValue(dest1).serialize_value(&code_, target1);
-    IntValue(dest2).serialize_value(&code_, target2);
+    serialize_int32(dest1, &code_, target1);
+    serialize_int32(dest2, &code_, target2);
 
     return absl::OkStatus();
 }
 
 absl::Status Compiler::operator()(const LetExpr& e) {
+    const bool tail = tail_;
     push_scope();
     for (const auto& [name, expr] : e.bindings) {
-        int pos = top_scope().size();
-        if (auto status = std::visit(*this, expr); !status.ok()) return status;
-        top_scope().emplace(name, pos);
+        int slot = function().depth;
+        if (auto status = visit(*expr); !status.ok()) return status;
+        top_scope()[name.id] = slot;
     }
-    if (auto status = std::visit(*this, *e.body); !status.ok()) return status;
+    // a tail call in the body discards the bindings along with the frame,
+    // so the cleanup below only runs if the body returns here
+    if (auto status = visit(*e.body, tail); !status.ok()) return status;
     for (int i = 0; i < e.bindings.size(); i++) {
-        push(Opcode::Swap);
-        push(Opcode::Pop);
+        emit(Opcode::Swap);
+        emit(Opcode::Pop);
     }
     pop_scope();
     return absl::OkStatus();
 }
 
+absl::Status Compiler::operator()(const BuiltinExpr& e) {
+    for (const Expr* arg : e.args) {
+        if (auto status = visit(*arg); !status.ok()) return status;
+    }
+    switch (e.op) {
+        case Builtin::Cons: emit(Opcode::Cons); break;
+        case Builtin::Car: emit(Opcode::Car); break;
+        case Builtin::Cdr: emit(Opcode::Cdr); break;
+        case Builtin::IsNil: emit(Opcode::IsNil); break;
+        case Builtin::Add: emit(Opcode::Add); break;
+        case Builtin::Sub: emit(Opcode::Sub); break;
+        case Builtin::Mul: emit(Opcode::Mul); break;
+        case Builtin::Lt: emit(Opcode::Lt); break;
+        case Builtin::Gt: emit(Opcode::Gt); break;
+        case Builtin::Eq: emit(Opcode::Eq); break;
+    }
+    return absl::OkStatus();
+}
+
+absl::Status Compiler::operator()(const LambdaExpr& e) {
+    return lambda(e, std::nullopt);
+}
+
+absl::Status Compiler::lambda(const LambdaExpr& e,
+                              std::optional<int> memo_table) {
+    // skip over the body, which only runs when the closure is called
+    auto target = code_.size() + 1;
+    emit(Opcode::Jmp, {0});
+    const int entry = code_.size();
+
+    const int arity = e.params.size();
+    functions_.push_back(Function{.depth = arity});
+    push_scope();
+    for (int i = 0; i < arity; i++) top_scope()[e.params[i].id] = i;
+    if (memo_table.has_value()) {
+        // on a hit, jump straight to the return with the cached result
+        auto hit = code_.size() + 1;
+        emit(Opcode::MemoGet, {0, *memo_table});
+        if (auto status = visit(*e.body); !status.ok()) return status;
+        emit(Opcode::MemoPut, {*memo_table});
+        serialize_int32(code_.size(), &code_, hit);
+    } else if (auto status = visit(*e.body, true); !status.ok()) {
+        return status;
+    }
+    emit(Opcode::Ret);
+    const auto captures = std::move(function().captures);
+    functions_.pop_back();
+
+    serialize_int32(code_.size(), &code_, target);
+    for (const auto& capture : captures) load(capture.source);
+    emit(Opcode::MakeClosure,
+         {entry, arity, static_cast<int>(captures.size())});
+    return absl::OkStatus();
+}
+
+std::optional<int> Compiler::native_callee(const Expr& fn) {
+    const auto* sym = std::get_if<SymbolExpr>(&fn);
+    if (sym == nullptr || natives_ == nullptr) return std::nullopt;
+    if (resolve(functions_.size() - 1, sym->symbol.id).has_value()) {
+        return std::nullopt;
+    }
+    return natives_->lookup(sym->symbol.name);
+}
+
+absl::Status Compiler::operator()(const CallExpr& e) {
+    const bool tail = tail_;
+    if (auto index = native_callee(*e.fn)) {
+        const NativeFunction& native = natives_->functions()[*index];
+        if (e.args.size() != native.arity) {
+            return absl::InvalidArgumentError(absl::StrFormat(
+                "[line %d] compiler: %s takes %d arguments, got %d", e.line,
+                native.name, native.arity, e.args.size()));
+        }
+        // the arguments stay on the stack, where the vm passes them from
+        for (const Expr* arg : e.args) {
+            if (auto status = visit(*arg); !status.ok()) return status;
+        }
+        emit(Opcode::CallNative, {*index, static_cast<int>(e.args.size())});
+        return absl::OkStatus();
+    }
+    if (auto status = visit(*e.fn); !status.ok()) return status;
+    for (const Expr* arg : e.args) {
+        if (auto status = visit(*arg); !status.ok()) return status;
+    }
+    emit(tail ? Opcode::TailCall : Opcode::Call,
+         {static_cast<int>(e.args.size())});
+    return absl::OkStatus();
+}
+
 absl::Status Compiler::operator()(const Expr& e) {
     return std::visit(*this, e);
 }
 
-absl::StatusOr<std::vector<char>> Compiler::compile(
-    const std::vector<Stmt>& stmts) {
+absl::StatusOr<Chunk> Compiler::compile(const std::vector<Stmt>& stmts) {
     code_.clear();
+    constants_.clear();
+    constant_index_.clear();
+    functions_.assign(1, Function{});
+    const int num_globals = globals_.size();
     for (const auto& stmt : stmts) {
-        if (auto status = (*this)(stmt); !status.ok()) return status;
+        if (auto status = (*this)(stmt); !status.ok()) {
+            // forget the globals defined by this batch, since it won't run
+            absl::erase_if(globals_, [num_globals](const auto& global) {
+                return global.second >= num_globals;
+            });
+            global_names_.resize(num_globals);
+            return status;
+        }
     }
-    return code_;
+    Chunk chunk{.constants = constants_, .code = code_};
+    serialize_global_names(
+        GlobalNames{
+            .first = num_globals,
+            .names = {global_names_.begin() + num_globals,
+                      global_names_.end()},
+        },
+        &chunk.globals);
+    return chunk;
 }
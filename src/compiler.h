@@ -1,50 +1,124 @@
 #ifndef COMPILER_H_
 #define COMPILER_H_
 
+#include <initializer_list>
 #include <map>
 #include <memory>
-#include <stdexcept>
+#include <optional>
+#include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/statusor.h"
 #include "ast.h"
+#include "chunk.h"
 #include "instr.h"
+#include "native.h"
 #include "value.h"
 
+// Compiles statements one batch at a time. Each call to compile returns a
+// self-contained chunk with just the code for that batch, while globals
+// defined by earlier batches stay visible to later ones. A batch that fails
+// to compile leaves no globals behind.
+//
+// Function bodies are compiled inline, behind a jump that skips over them.
+// Locals are addressed by their slot in the frame: a function's arguments
+// occupy the first slots and let bindings the ones above them. Variables
+// of enclosing functions are copied into the closure when it is created.
+// Calls in tail position reuse the caller's frame, so loops written as
+// tail recursion run in constant space. The body of a memoized function
+// looks up its arguments in a memo table first and records its result
+// before returning, so its calls are never tail calls.
 class Compiler final {
 public:
-    absl::StatusOr<std::vector<char>> compile(const std::vector<Stmt>& stmts);
+    absl::StatusOr<Chunk> compile(const std::vector<Stmt>& stmts);
 
     // interactive mode prints the value that is on top of the stack after
     // each statement
     void set_interactive(bool interactive) { interactive_ = interactive; }
+    // Calls to |natives| by name compile to CallNative, unless a variable
+    // of the same name is in scope. |natives| must outlive the Compiler.
+    void set_natives(const Natives* natives) { natives_ = natives; }
 
     // Visitor:
     absl::Status operator()(const Expr& s);
     absl::Status operator()(const Stmt& s);
+    absl::Status operator()(const DefineStmt& s);
     absl::Status operator()(const BoolExpr& lit);
     absl::Status operator()(const IntExpr& lit);
+    absl::Status operator()(const NilExpr& lit);
     absl::Status operator()(const IfExpr& e);
     absl::Status operator()(const LetExpr& e);
     absl::Status operator()(const SymbolExpr& e);
+    absl::Status operator()(const BuiltinExpr& e);
+    absl::Status operator()(const LambdaExpr& e);
+    absl::Status operator()(const CallExpr& e);
 
 private:
-    using Scope = std::map<std::string, int>;
-
-    void push(Opcode op) { serialize_opcode(op, &code_); }
-    void push(const Value& value) { value.serialize(&code_); }
-    void push_scope() { scopes_.emplace_back(); }
-    void pop_scope() {
-        if (scopes_.empty()) {
-            throw new std::logic_error("compiling at global scope, cannot pop");
-        }
-        scopes_.pop_back();
-    }
-    Scope& top_scope() { return scopes_.back(); }
+    // slot of each binding in the scope, keyed by symbol id
+    using Scope = absl::flat_hash_map<int, int>;
+
+    struct Variable {
+        enum class Kind { Local, Capture, Global };
+        Kind kind;
+        // frame slot, capture index or global slot
+        int index;
+    };
+
+    struct Capture {
+        int id;
+        // where the captured value lives in the enclosing function
+        Variable source;
+    };
+
+    // the function being compiled, or the top level
+    struct Function {
+        std::vector<Scope> scopes;
+        // number of values in the frame, which is the slot of the next
+        // value that is pushed
+        int depth = 0;
+        std::vector<Capture> captures;
+    };
+
+    // compiles |e|, which is in tail position if |tail| is set
+    absl::Status visit(const Expr& e, bool tail = false);
+    // emits |op| and its operands, tracking the depth of the frame
+    void emit(Opcode op, std::initializer_list<int> operands = {});
+    // emits a Push of |value|, adding it to the constant pool if necessary
+    void push_constant(const Value& value);
+    // emits the instruction that pushes |var|
+    void load(Variable var);
+    // finds the variable |id| refers to in the |level|th enclosing function,
+    // capturing it from the functions around that one if needed
+    std::optional<Variable> resolve(int level, int id);
+    // compiles the closure for |e|, whose body caches its results in memo
+    // table |memo_table| if there is one
+    absl::Status lambda(const LambdaExpr& e, std::optional<int> memo_table);
+    // the native function that calling |fn| calls, if it's the name of one
+    // and not of a variable
+    std::optional<int> native_callee(const Expr& fn);
+
+    Function& function() { return functions_.back(); }
+    void push_scope() { function().scopes.emplace_back(); }
+    void pop_scope() { function().scopes.pop_back(); }
+    Scope& top_scope() { return function().scopes.back(); }
 
     bool interactive_ = false;
+    const Natives* natives_ = nullptr;
+    // is the expression being compiled the last thing its function does?
+    bool tail_ = false;
     std::vector<char> code_;
-    std::vector<Scope> scopes_;
+    std::vector<char> constants_;
+    // pool index for each serialized constant, used for deduplication
+    std::map<std::string, int> constant_index_;
+    // innermost last
+    std::vector<Function> functions_;
+    // slot of each global, keyed by symbol id
+    absl::flat_hash_map<int, int> globals_;
+    // name of each global, by slot
+    std::vector<std::string> global_names_;
+    // tables are numbered across batches, since the vm keeps their contents
+    int num_memo_tables_ = 0;
 };
 
 #endif  // COMPILER_H_
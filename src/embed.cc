@@ -0,0 +1,28 @@
+#include "embed.h"
+
+#include "arena.h"
+#include "compiler.h"
+#include "fold.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "scanner.h"
+#include "symbols.h"
+
+absl::StatusOr<std::shared_ptr<const Program>> compile_program(
+    std::string_view text, const CompileOptions& options) {
+    SymbolTable symbols;
+    auto toks = scan(text, &symbols);
+    if (!toks.ok()) return toks.status();
+    Arena arena;
+    auto stmts = parse(*toks, &arena);
+    if (!stmts.ok()) return stmts.status();
+    if (options.optimize) stmts = fold(*stmts, &arena);
+
+    Compiler compiler;
+    compiler.set_interactive(options.interactive);
+    compiler.set_natives(options.natives.get());
+    auto chunk = compiler.compile(*stmts);
+    if (chunk.ok() && options.optimize) chunk = optimize(*chunk);
+    if (!chunk.ok()) return chunk.status();
+    return Program::load(chunk->view(), options.natives);
+}
@@ -0,0 +1,64 @@
+#ifndef EMBED_H_
+#define EMBED_H_
+
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "native.h"
+#include "program.h"
+#include "vm.h"
+
+// The API for embedding june in a server or other long-running host. Source
+// is compiled once into a Program, and each request then runs it on a fresh
+// Isolate, which costs a heap and a stack rather than a trip through the
+// scanner, parser and compiler:
+//
+//     auto program = compile_program(text);
+//     ...
+//     // on any thread
+//     Isolate isolate(*program);
+//     absl::Status status = isolate.run();
+
+struct CompileOptions {
+    // folds constants and runs the peephole optimizer
+    bool optimize = true;
+    // prints the value of each top-level expression, as the repl does
+    bool interactive = false;
+    // the native functions the program can call, which it keeps alive
+    std::shared_ptr<const Natives> natives;
+};
+
+// scans, parses and compiles |text| into a program that any number of
+// isolates can share
+absl::StatusOr<std::shared_ptr<const Program>> compile_program(
+    std::string_view text, const CompileOptions& options = {});
+
+// A VM that runs a single shared Program. Each isolate has its own stack,
+// heap and globals, so isolates on different threads run independently;
+// an isolate itself must only be used by one thread at a time.
+class Isolate final {
+public:
+    explicit Isolate(std::shared_ptr<const Program> program)
+        : program_(std::move(program)) {}
+
+    // runs the program from its start, reporting the first error. Globals
+    // defined by an earlier run stay defined.
+    absl::Status run() { return vm_.execute(program_); }
+
+    // Print writes to |out|, which must outlive the Isolate
+    void set_output(std::ostream* out) { vm_.set_output(out); }
+    void set_jit(bool jit) { vm_.set_jit(jit); }
+    const HeapStats& heap_stats() const { return vm_.heap_stats(); }
+    void set_memo_capacity(int capacity) { vm_.set_memo_capacity(capacity); }
+    MemoStats memo_stats() const { return vm_.memo_stats(); }
+
+private:
+    std::shared_ptr<const Program> program_;
+    VM vm_;
+};
+
+#endif  // EMBED_H_
@@ -2,36 +2,64 @@
 
 #include "absl/strings/str_format.h"
 
-void Evaluator::evaluate(std::string_view text) {
-    auto toks = scan(text);
-    if (!toks.ok()) {
-        handler_(toks.status());
-        return;
-    }
+absl::StatusOr<Chunk> Evaluator::compile(std::string_view text) {
+    auto toks = scan(text, &symbols_);
+    if (!toks.ok()) return toks.status();
+    return compile(*toks);
+}
+
+absl::StatusOr<Chunk> Evaluator::compile(const std::vector<Token>& toks) {
     if (log_tokens_) {
-        for (const auto& tok : *toks) absl::PrintF("%s\n", tok.str());
+        for (const auto& tok : toks) absl::PrintF("%s\n", tok.str());
     }
 
-    auto stmts = parse(toks.value());
-    if (!stmts.ok()) {
-        handler_(stmts.status());
-        return;
-    }
+    // the ast is only needed until it has been compiled
+    Arena arena;
+    auto stmts = parse(toks, &arena);
+    if (!stmts.ok()) return stmts.status();
+    if (optimize_) stmts = fold(*stmts, &arena);
     if (log_ast_) {
         for (const auto& stmt : *stmts) absl::PrintF("%s\n", to_string(stmt));
     }
 
     auto code = compiler_.compile(stmts.value());
-    if (!code.ok()) {
-        handler_(code.status());
-        return;
-    }
+    if (code.ok() && optimize_) code = optimize(*code);
+    if (!code.ok()) return code.status();
     if (log_code_) {
-        for (char ch : *code) absl::PrintF("0x%02X\n", ch);
+        absl::PrintF("constants:\n");
+        for (char ch : code->constants) absl::PrintF("0x%02X\n", ch);
+        absl::PrintF("code:\n");
+        for (char ch : code->code) absl::PrintF("0x%02X\n", ch);
     }
+    return code;
+}
 
-    auto status = vm_.execute(*code);
+void Evaluator::execute(ChunkView chunk) {
+    auto status = vm_.execute(chunk);
     if (!status.ok()) {
         handler_(status);
     }
 }
+
+void Evaluator::evaluate(std::string_view text) {
+    auto code = compile(text);
+    if (!code.ok()) {
+        handler_(code.status());
+        return;
+    }
+    execute(code->view());
+}
+
+void Evaluator::run_script(std::string_view text) {
+    StmtScanner scanner(text, &symbols_);
+    while (true) {
+        auto toks = scanner.next();
+        if (!toks.ok()) return handler_(toks.status());
+        if (toks->empty()) return;
+        auto code = compile(*toks);
+        if (!code.ok()) return handler_(code.status());
+        if (auto status = vm_.execute(code->view()); !status.ok()) {
+            return handler_(status);
+        }
+    }
+}
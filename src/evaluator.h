@@ -2,11 +2,19 @@
 #define EVALUATOR_H_
 
 #include <functional>
+#include <ostream>
+#include <vector>
 
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "chunk.h"
 #include "compiler.h"
+#include "fold.h"
+#include "native.h"
+#include "optimizer.h"
 #include "parser.h"
 #include "scanner.h"
+#include "symbols.h"
 #include "vm.h"
 
 class Evaluator final {
@@ -14,7 +22,18 @@ public:
     using ErrorHandler = std::function<void(absl::Status)>;
 
     Evaluator(ErrorHandler handler) : handler_(handler) {}
+
+    // scans, parses and compiles |text| without running it
+    absl::StatusOr<Chunk> compile(std::string_view text);
+    // runs compiled code, reporting errors to the handler
+    void execute(ChunkView chunk);
+    // compiles and runs |text|, reporting errors to the handler
     void evaluate(std::string_view text);
+    // Like evaluate, but scans, parses, compiles and runs |text| one
+    // statement at a time, so the first statement runs before the rest is
+    // scanned and only one statement's tokens and ast are held at once.
+    // Statements before one that fails have already run.
+    void run_script(std::string_view text);
 
     void set_interactive(bool interactive) {
         compiler_.set_interactive(interactive);
@@ -23,14 +42,34 @@ public:
     void set_log_ast(bool log_ast) { log_ast_ = log_ast; }
     void set_log_code(bool log_code) { log_code_ = log_code; }
     void set_log_vm(bool log_vm) { vm_.set_log(log_vm); }
+    void set_optimize(bool optimize) { optimize_ = optimize; }
+    void set_jit(bool jit) { vm_.set_jit(jit); }
+    // makes |natives| callable from scripts; |natives| must outlive the
+    // Evaluator
+    void set_natives(const Natives* natives) {
+        compiler_.set_natives(natives);
+        vm_.set_natives(natives);
+    }
+    // |out| must outlive the Evaluator
+    void set_output(std::ostream* out) { vm_.set_output(out); }
+
+    const HeapStats& heap_stats() const { return vm_.heap_stats(); }
+    JitStats jit_stats() const { return vm_.jit_stats(); }
+    void set_memo_capacity(int capacity) { vm_.set_memo_capacity(capacity); }
+    MemoStats memo_stats() const { return vm_.memo_stats(); }
 
 private:
+    // parses and compiles the statements in |toks|
+    absl::StatusOr<Chunk> compile(const std::vector<Token>& toks);
+
     ErrorHandler handler_;
+    SymbolTable symbols_;
     Compiler compiler_;
     VM vm_;
     bool log_tokens_ = false;
     bool log_ast_ = false;
     bool log_code_ = false;
+    bool optimize_ = false;
 };
 
 #endif  // EVALUATOR_H_
@@ -0,0 +1,252 @@
+#include "fold.h"
+
+#include <optional>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+
+namespace {
+
+bool is_literal(const Expr& e) {
+    return std::holds_alternative<BoolExpr>(e) ||
+           std::holds_alternative<IntExpr>(e) ||
+           std::holds_alternative<NilExpr>(e);
+}
+
+// Does |e| refer to the binding of |id| that is visible where |e| occurs?
+struct References {
+    int id;
+
+    bool operator()(const BoolExpr& e) const { return false; }
+    bool operator()(const IntExpr& e) const { return false; }
+    bool operator()(const NilExpr& e) const { return false; }
+    bool operator()(const SymbolExpr& e) const { return e.symbol.id == id; }
+
+    bool operator()(const IfExpr& e) const {
+        return std::visit(*this, *e.cond) || std::visit(*this, *e.conseq) ||
+               std::visit(*this, *e.alt);
+    }
+
+    bool operator()(const LetExpr& e) const {
+        for (const auto& [name, value] : e.bindings) {
+            if (std::visit(*this, *value)) return true;
+            if (name.id == id) return false;
+        }
+        return std::visit(*this, *e.body);
+    }
+
+    bool operator()(const BuiltinExpr& e) const { return any(e.args); }
+
+    bool operator()(const LambdaExpr& e) const {
+        for (const auto& param : e.params) {
+            if (param.id == id) return false;
+        }
+        return std::visit(*this, *e.body);
+    }
+
+    bool operator()(const CallExpr& e) const {
+        return std::visit(*this, *e.fn) || any(e.args);
+    }
+
+    bool any(absl::Span<const Expr* const> exprs) const {
+        for (const Expr* e : exprs) {
+            if (std::visit(*this, *e)) return true;
+        }
+        return false;
+    }
+};
+
+class Folder final {
+public:
+    explicit Folder(Arena* arena) : arena_(arena) {}
+
+    Expr operator()(const BoolExpr& e) { return e; }
+    Expr operator()(const IntExpr& e) { return e; }
+    Expr operator()(const NilExpr& e) { return e; }
+
+    Expr operator()(const SymbolExpr& e) {
+        for (auto it = scopes_.rbegin(); it != scopes_.rend(); ++it) {
+            auto binding = it->find(e.symbol.id);
+            if (binding == it->end()) continue;
+            if (binding->second == nullptr) break;
+            return with_line(*binding->second, e.line);
+        }
+        return e;
+    }
+
+    Expr operator()(const IfExpr& e) {
+        Expr cond = std::visit(*this, *e.cond);
+        if (auto* lit = std::get_if<BoolExpr>(&cond)) {
+            return std::visit(*this, lit->value ? *e.conseq : *e.alt);
+        }
+        return IfExpr{
+            .line = e.line,
+            .cond = make(std::move(cond)),
+            .conseq = make(std::visit(*this, *e.conseq)),
+            .alt = make(std::visit(*this, *e.alt)),
+        };
+    }
+
+    Expr operator()(const LetExpr& e) {
+        // fold the bindings in order, remembering which ones are literals
+        // and which can be dropped if they turn out to be unused
+        absl::InlinedVector<Binding, 8> bindings;
+        absl::InlinedVector<bool, 8> pure;
+        scopes_.emplace_back();
+        for (const auto& [name, value] : e.bindings) {
+            const Expr* folded = make(std::visit(*this, *value));
+            pure.push_back(is_pure(*folded));
+            scopes_.back()[name.id] = is_literal(*folded) ? folded : nullptr;
+            bindings.push_back(Binding{.name = name, .value = folded});
+        }
+        Expr body = std::visit(*this, *e.body);
+        scopes_.pop_back();
+
+        // walk backwards so that we know which later bindings are kept
+        const int n = bindings.size();
+        absl::InlinedVector<bool, 8> keep(n);
+        for (int i = n - 1; i >= 0; i--) {
+            keep[i] = !pure[i] || is_used(i, bindings, keep, body);
+        }
+        absl::InlinedVector<Binding, 8> kept;
+        for (int i = 0; i < n; i++) {
+            if (keep[i]) kept.push_back(bindings[i]);
+        }
+        if (kept.empty()) return body;
+        return LetExpr{
+            .line = e.line,
+            .bindings = arena_->copy(absl::MakeConstSpan(kept)),
+            .body = make(std::move(body)),
+        };
+    }
+
+    Expr operator()(const BuiltinExpr& e) {
+        auto args = fold_all(e.args);
+        if (auto folded = fold_arithmetic(e.line, e.op, args)) {
+            return *folded;
+        }
+        return BuiltinExpr{.line = e.line, .op = e.op, .args = args};
+    }
+
+    Expr operator()(const LambdaExpr& e) {
+        // the parameters hide any constants with the same names
+        scopes_.emplace_back();
+        for (const auto& param : e.params) scopes_.back()[param.id] = nullptr;
+        Expr body = std::visit(*this, *e.body);
+        scopes_.pop_back();
+        return LambdaExpr{
+            .line = e.line,
+            .params = e.params,
+            .body = make(std::move(body)),
+        };
+    }
+
+    Expr operator()(const CallExpr& e) {
+        return CallExpr{
+            .line = e.line,
+            .fn = make(std::visit(*this, *e.fn)),
+            .args = fold_all(e.args),
+        };
+    }
+
+private:
+    absl::Span<const Expr* const> fold_all(
+        absl::Span<const Expr* const> exprs) {
+        absl::InlinedVector<const Expr*, 4> folded;
+        for (const Expr* e : exprs) {
+            folded.push_back(make(std::visit(*this, *e)));
+        }
+        return arena_->copy(absl::MakeConstSpan(folded));
+    }
+
+    // Evaluates |op| if it's arithmetic or a comparison on integer
+    // literals. Results that overflow a fixnum are left for the vm, which
+    // promotes them to bignums.
+    static std::optional<Expr> fold_arithmetic(
+        int line, Builtin op, absl::Span<const Expr* const> args) {
+        if (args.size() != 2) return std::nullopt;
+        const auto* a = std::get_if<IntExpr>(args[0]);
+        const auto* b = std::get_if<IntExpr>(args[1]);
+        if (a == nullptr || b == nullptr) return std::nullopt;
+        int64_t result;
+        switch (op) {
+            case Builtin::Add:
+                if (__builtin_add_overflow(a->value, b->value, &result)) break;
+                return IntExpr{.line = line, .value = result};
+            case Builtin::Sub:
+                if (__builtin_sub_overflow(a->value, b->value, &result)) break;
+                return IntExpr{.line = line, .value = result};
+            case Builtin::Mul:
+                if (__builtin_mul_overflow(a->value, b->value, &result)) break;
+                return IntExpr{.line = line, .value = result};
+            case Builtin::Lt:
+                return BoolExpr{.line = line, .value = a->value < b->value};
+            case Builtin::Gt:
+                return BoolExpr{.line = line, .value = a->value > b->value};
+            case Builtin::Eq:
+                return BoolExpr{.line = line, .value = a->value == b->value};
+            default: break;
+        }
+        return std::nullopt;
+    }
+
+    const Expr* make(Expr e) { return arena_->make<Expr>(std::move(e)); }
+
+    // Can evaluating |e| fail or have other effects? Only locals are sure
+    // to be defined: a global may not be, or its define may have failed,
+    // and other names may be undefined or native functions, which are
+    // errors to use as values.
+    bool is_pure(const Expr& e) const {
+        if (is_literal(e)) return true;
+        const auto* sym = std::get_if<SymbolExpr>(&e);
+        if (sym == nullptr) return false;
+        for (const auto& scope : scopes_) {
+            if (scope.contains(sym->symbol.id)) return true;
+        }
+        return false;
+    }
+
+    static Expr with_line(Expr e, int line) {
+        std::visit([line](auto& node) { node.line = line; }, e);
+        return e;
+    }
+
+    // Is the |i|th binding referenced by a later binding that is kept, or
+    // by the body if no later binding shadows it?
+    static bool is_used(int i, absl::Span<const Binding> bindings,
+                        absl::Span<const bool> keep, const Expr& body) {
+        References refs{.id = bindings[i].name.id};
+        for (int j = i + 1; j < bindings.size(); j++) {
+            if (keep[j] && std::visit(refs, *bindings[j].value)) return true;
+            if (bindings[j].name.id == refs.id) return false;
+        }
+        return std::visit(refs, body);
+    }
+
+    Arena* arena_;
+    // constant value of each binding in scope, or nullptr if the binding
+    // isn't a literal
+    std::vector<absl::flat_hash_map<int, const Expr*>> scopes_;
+};
+
+}  // namespace
+
+std::vector<Stmt> fold(const std::vector<Stmt>& stmts, Arena* arena) {
+    Folder folder(arena);
+    std::vector<Stmt> folded;
+    folded.reserve(stmts.size());
+    for (const auto& stmt : stmts) {
+        // globals can be redefined, so only their values are folded
+        if (const auto* def = std::get_if<DefineStmt>(&stmt)) {
+            folded.push_back(DefineStmt{
+                .line = def->line,
+                .name = def->name,
+                .value = arena->make<Expr>(std::visit(folder, *def->value)),
+                .memo = def->memo,
+            });
+        } else {
+            folded.push_back(std::visit(folder, std::get<Expr>(stmt)));
+        }
+    }
+    return folded;
+}
@@ -0,0 +1,23 @@
+#ifndef FOLD_H_
+#define FOLD_H_
+
+#include <vector>
+
+#include "arena.h"
+#include "ast.h"
+
+// Simplifies the ast before it is compiled:
+//
+// - let bindings to literals are propagated into the expressions that
+//   refer to them
+// - an if whose condition is a literal boolean is replaced by the arm that
+//   would be taken
+// - let bindings that are never referenced are dropped when evaluating
+//   them can have no effect, which is when they are literals or locals,
+//   and a let without bindings is replaced by its body
+//
+// New nodes are allocated in |arena|; unchanged subtrees are shared with
+// the input.
+std::vector<Stmt> fold(const std::vector<Stmt>& stmts, Arena* arena);
+
+#endif  // FOLD_H_
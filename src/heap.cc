@@ -0,0 +1,82 @@
+#include "heap.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+template <typename Visit>
+void for_each_field(Object* obj, Visit visit) {
+    switch (obj->typ) {
+        case Type::Pair: {
+            auto* pair = static_cast<Pair*>(obj);
+            visit(&pair->car);
+            visit(&pair->cdr);
+            break;
+        }
+        case Type::Closure: {
+            auto* closure = static_cast<Closure*>(obj);
+            for (int i = 0; i < closure->num_captures; i++) {
+                visit(&closure->captures()[i]);
+            }
+            break;
+        }
+        default: break;
+    }
+}
+
+}  // namespace
+
+Heap::Heap(size_t semispace_size)
+    : space_(new char[semispace_size]),
+      capacity_(semispace_size),
+      next_(space_.get()),
+      end_(space_.get() + semispace_size) {}
+
+void Heap::copy(RootSet roots, size_t capacity) {
+    std::unique_ptr<char[]> to;
+    if (capacity == capacity_ && spare_) to = std::move(spare_);
+    else to.reset(new char[capacity]);
+
+    char* next = to.get();
+    auto evacuate = [&next](TaggedValue* value) {
+        if (!is_object(value->typ)) return;
+        Object* obj = value->as.obj;
+        if (obj->forwarded == nullptr) {
+            std::memcpy(next, obj, obj->size);
+            obj->forwarded = reinterpret_cast<Object*>(next);
+            next += obj->size;
+        }
+        value->as.obj = obj->forwarded;
+    };
+    roots(evacuate);
+    // the objects between |scan| and |next| have been copied but their
+    // fields still point into the old semispace
+    for (char* scan = to.get(); scan < next;) {
+        auto* obj = reinterpret_cast<Object*>(scan);
+        for_each_field(obj, evacuate);
+        scan += obj->size;
+    }
+
+    if (capacity == capacity_) spare_ = std::move(space_);
+    else spare_.reset();
+    space_ = std::move(to);
+    capacity_ = capacity;
+    next_ = next;
+    end_ = space_.get() + capacity;
+}
+
+void Heap::collect(RootSet roots, size_t size) {
+    auto start = absl::Now();
+    copy(roots, capacity_);
+    // keep the heap at most half full so that collections stay infrequent
+    size_t live = next_ - space_.get();
+    size_t want = 2 * (live + align(size));
+    if (want > capacity_) copy(roots, std::max(want, 2 * capacity_));
+
+    auto pause = absl::Now() - start;
+    stats_.collections++;
+    stats_.bytes_live = next_ - space_.get();
+    stats_.total_pause += pause;
+    stats_.max_pause = std::max(stats_.max_pause, pause);
+}
@@ -0,0 +1,91 @@
+#ifndef HEAP_H_
+#define HEAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "absl/functional/function_ref.h"
+#include "absl/time/time.h"
+#include "value.h"
+
+struct HeapStats {
+    // total bytes handed out since the heap was created
+    int64_t bytes_allocated = 0;
+    int64_t collections = 0;
+    // bytes that survived the last collection
+    int64_t bytes_live = 0;
+    absl::Duration total_pause;
+    absl::Duration max_pause;
+};
+
+// A garbage-collected heap for pairs, closures and other objects. Objects are
+// bump-allocated in the active semispace, and a collection copies the
+// objects reachable from the roots into the other semispace (Cheney's
+// algorithm), so dead objects cost nothing to free. Collection is precise:
+// the roots are exactly the values the owner passes to the collector, and
+// objects are only ever referred to from TaggedValues.
+class Heap final {
+public:
+    // called on each root, which the collector updates if its object moved
+    using RootVisitor = absl::FunctionRef<void(TaggedValue*)>;
+    // calls the visitor on every root
+    using RootSet = absl::FunctionRef<void(RootVisitor)>;
+
+    static constexpr size_t kInitialSemispaceSize = 256 << 10;
+
+    explicit Heap(size_t semispace_size = kInitialSemispaceSize);
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+    Heap(Heap&& other)
+        : space_(std::move(other.space_)),
+          spare_(std::move(other.spare_)),
+          capacity_(std::exchange(other.capacity_, 0)),
+          next_(std::exchange(other.next_, nullptr)),
+          end_(std::exchange(other.end_, nullptr)),
+          stats_(other.stats_) {}
+
+    // returns an object of type |typ| with uninitialized fields, or nullptr
+    // if the heap must be collected first
+    template <typename T>
+    T* try_allocate(Type typ, size_t size = sizeof(T)) {
+        size = align(size);
+        if (bytes_free() < size) return nullptr;
+        T* obj = new (next_) T;
+        next_ += size;
+        obj->typ = typ;
+        obj->size = size;
+        obj->forwarded = nullptr;
+        stats_.bytes_allocated += size;
+        return obj;
+    }
+
+    // frees everything that isn't reachable from |roots|, growing the heap
+    // if needed so that at least |size| bytes can be allocated afterwards
+    void collect(RootSet roots, size_t size);
+
+    size_t capacity() const { return capacity_; }
+    size_t bytes_free() const { return static_cast<size_t>(end_ - next_); }
+    const HeapStats& stats() const { return stats_; }
+
+private:
+    static size_t align(size_t size) {
+        constexpr size_t kAlign = alignof(std::max_align_t);
+        return (size + kAlign - 1) & ~(kAlign - 1);
+    }
+
+    // copies the live objects into a fresh semispace of |capacity| bytes
+    void copy(RootSet roots, size_t capacity);
+
+    std::unique_ptr<char[]> space_;
+    // the previous semispace, kept to be reused by the next collection
+    std::unique_ptr<char[]> spare_;
+    size_t capacity_;
+    char* next_;
+    char* end_;
+    HeapStats stats_;
+};
+
+#endif  // HEAP_H_
@@ -1,6 +1,136 @@
 #include "instr.h"
 
+#include <unordered_map>
+
 #include "absl/strings/str_format.h"
+#include "value.h"
+
+std::string to_string(Opcode op) {
+    switch (op) {
+        case Opcode::Push: return "PUSH";
+        case Opcode::Pop: return "POP";
+        case Opcode::Print: return "PRINT";
+        case Opcode::JmpIfNot: return "JMP_IF_NOT";
+        case Opcode::Jmp: return "JMP";
+        case Opcode::Swap: return "SWAP";
+        case Opcode::Get: return "GET";
+        case Opcode::Halt: return "HALT";
+        case Opcode::Slide: return "SLIDE";
+        case Opcode::Get2: return "GET2";
+        case Opcode::GetGlobal: return "GET_GLOBAL";
+        case Opcode::SetGlobal: return "SET_GLOBAL";
+        case Opcode::Cons: return "CONS";
+        case Opcode::Car: return "CAR";
+        case Opcode::Cdr: return "CDR";
+        case Opcode::IsNil: return "IS_NIL";
+        case Opcode::MakeClosure: return "MAKE_CLOSURE";
+        case Opcode::GetCapture: return "GET_CAPTURE";
+        case Opcode::Call: return "CALL";
+        case Opcode::Ret: return "RET";
+        case Opcode::TailCall: return "TAIL_CALL";
+        case Opcode::Add: return "ADD";
+        case Opcode::Sub: return "SUB";
+        case Opcode::Mul: return "MUL";
+        case Opcode::Lt: return "LT";
+        case Opcode::Gt: return "GT";
+        case Opcode::Eq: return "EQ";
+        case Opcode::JmpIfNotLt: return "JMP_IF_NOT_LT";
+        case Opcode::JmpIfNotGt: return "JMP_IF_NOT_GT";
+        case Opcode::JmpIfNotEq: return "JMP_IF_NOT_EQ";
+        case Opcode::CallNative: return "CALL_NATIVE";
+        case Opcode::MemoGet: return "MEMO_GET";
+        case Opcode::MemoPut: return "MEMO_PUT";
+    }
+}
+
+int operand_count(Opcode op) {
+    switch (op) {
+        case Opcode::Push:
+        case Opcode::JmpIfNot:
+        case Opcode::Jmp:
+        case Opcode::Get:
+        case Opcode::Slide:
+        case Opcode::GetGlobal:
+        case Opcode::SetGlobal:
+        case Opcode::GetCapture:
+        case Opcode::Call:
+        case Opcode::TailCall:
+        case Opcode::JmpIfNotLt:
+        case Opcode::JmpIfNotGt:
+        case Opcode::JmpIfNotEq:
+        case Opcode::MemoPut: return 1;
+        case Opcode::Get2:
+        case Opcode::CallNative:
+        case Opcode::MemoGet: return 2;
+        case Opcode::MakeClosure: return 3;
+        case Opcode::Pop:
+        case Opcode::Print:
+        case Opcode::Swap:
+        case Opcode::Halt:
+        case Opcode::Cons:
+        case Opcode::Car:
+        case Opcode::Cdr:
+        case Opcode::IsNil:
+        case Opcode::Ret:
+        case Opcode::Add:
+        case Opcode::Sub:
+        case Opcode::Mul:
+        case Opcode::Lt:
+        case Opcode::Gt:
+        case Opcode::Eq: return 0;
+    }
+}
+
+int stack_effect(const Instr& instr) {
+    switch (instr.op) {
+        case Opcode::Push:
+        case Opcode::Get:
+        case Opcode::GetGlobal:
+        case Opcode::GetCapture: return 1;
+        case Opcode::Get2: return 2;
+        case Opcode::Pop:
+        case Opcode::JmpIfNot:
+        case Opcode::SetGlobal:
+        case Opcode::Cons:
+        case Opcode::Add:
+        case Opcode::Sub:
+        case Opcode::Mul:
+        case Opcode::Lt:
+        case Opcode::Gt:
+        case Opcode::Eq: return -1;
+        case Opcode::JmpIfNotLt:
+        case Opcode::JmpIfNotGt:
+        case Opcode::JmpIfNotEq: return -2;
+        case Opcode::Slide: return -instr.arg;
+        case Opcode::MakeClosure: return 1 - instr.arg3;
+        case Opcode::Call:
+        case Opcode::TailCall: return -instr.arg;
+        case Opcode::CallNative: return 1 - instr.arg2;
+        case Opcode::Print:
+        case Opcode::Jmp:
+        case Opcode::Swap:
+        case Opcode::Halt:
+        case Opcode::Car:
+        case Opcode::Cdr:
+        case Opcode::IsNil:
+        case Opcode::Ret:
+        case Opcode::MemoGet:
+        case Opcode::MemoPut: return 0;
+    }
+}
+
+bool has_target(Opcode op) {
+    switch (op) {
+        case Opcode::Jmp:
+        case Opcode::JmpIfNot:
+        case Opcode::JmpIfNotLt:
+        case Opcode::JmpIfNotGt:
+        case Opcode::JmpIfNotEq:
+        case Opcode::MakeClosure:
+        case Opcode::MemoGet: return true;
+        default: return false;
+    }
+}
 
 void serialize_opcode(Opcode op, std::vector<char>* buf) {
     buf->push_back(static_cast<char>(op));
@@ -15,6 +145,86 @@ absl::StatusOr<Opcode> deserialize_opcode(char op) {
         case 5: return Opcode::Jmp;
         case 6: return Opcode::Swap;
         case 7: return Opcode::Get;
+        case 8: return Opcode::Halt;
+        case 9: return Opcode::Slide;
+        case 10: return Opcode::Get2;
+        case 11: return Opcode::GetGlobal;
+        case 12: return Opcode::SetGlobal;
+        case 13: return Opcode::Cons;
+        case 14: return Opcode::Car;
+        case 15: return Opcode::Cdr;
+        case 16: return Opcode::IsNil;
+        case 17: return Opcode::MakeClosure;
+        case 18: return Opcode::GetCapture;
+        case 19: return Opcode::Call;
+        case 20: return Opcode::Ret;
+        case 21: return Opcode::TailCall;
+        case 22: return Opcode::Add;
+        case 23: return Opcode::Sub;
+        case 24: return Opcode::Mul;
+        case 25: return Opcode::Lt;
+        case 26: return Opcode::Gt;
+        case 27: return Opcode::Eq;
+        case 28: return Opcode::JmpIfNotLt;
+        case 29: return Opcode::JmpIfNotGt;
+        case 30: return Opcode::JmpIfNotEq;
+        case 31: return Opcode::CallNative;
+        case 32: return Opcode::MemoGet;
+        case 33: return Opcode::MemoPut;
     }
     return absl::InvalidArgumentError(absl::StrFormat("bad opcode: %d", op));
 }
+
+absl::StatusOr<std::vector<Instr>> decode(absl::Span<const char> code) {
+    std::vector<Instr> instrs;
+    std::unordered_map<int, int> index_of;
+    int pc = 0;
+    while (pc < code.size()) {
+        index_of[pc] = instrs.size();
+        auto op = deserialize_opcode(code[pc++]);
+        if (!op.ok()) return op.status();
+        Instr instr{.op = *op};
+        int* operands[] = {&instr.arg, &instr.arg2, &instr.arg3};
+        for (int i = 0; i < operand_count(*op); i++) {
+            auto arg = deserialize_int32(code, pc);
+            if (!arg.ok()) return arg.status();
+            *operands[i] = *arg;
+            pc += 4;
+        }
+        instrs.push_back(instr);
+    }
+    index_of[pc] = instrs.size();
+
+    // rewrite targets from byte offsets to instruction indices
+    for (auto& instr : instrs) {
+        if (!has_target(instr.op)) continue;
+        auto it = index_of.find(instr.arg);
+        if (it == index_of.end()) {
+            return absl::InvalidArgumentError(
+                absl::StrFormat("bad target: %d", instr.arg));
+        }
+        instr.arg = it->second;
+    }
+    return instrs;
+}
+
+std::vector<char> encode(const std::vector<Instr>& instrs) {
+    std::vector<int> offset_of;
+    int pc = 0;
+    for (const auto& instr : instrs) {
+        offset_of.push_back(pc);
+        pc += 1 + 4 * operand_count(instr.op);
+    }
+    offset_of.push_back(pc);
+
+    std::vector<char> code;
+    for (const auto& instr : instrs) {
+        serialize_opcode(instr.op, &code);
+        int operands[] = {instr.arg, instr.arg2, instr.arg3};
+        if (has_target(instr.op)) operands[0] = offset_of[instr.arg];
+        for (int i = 0; i < operand_count(instr.op); i++) {
+            serialize_int32(operands[i], &code);
+        }
+    }
+    return code;
+}
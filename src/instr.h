@@ -1,13 +1,15 @@
 #ifndef INSTR_H_
 #define INSTR_H_
 
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 
 enum class Opcode {
-    // [Push Value]
+    // [Push Index]
     Push = 1,
     // [Pop]
     Pop = 2,
@@ -19,11 +21,115 @@ enum class Opcode {
     Jmp = 5,
     // [Swap]
     Swap = 6,
-    // [Get]
+    // [Get Slot]
+    // pushes the local in the slot, counted from the frame pointer
     Get = 7,
+    // [Halt]
+    // appended by the vm after the last instruction of a chunk
+    Halt = 8,
+    // [Slide N]
+    // keeps the top value and drops the N values beneath it
+    Slide = 9,
+    // [Get2 Slot Slot]
+    // equivalent to two consecutive Gets
+    Get2 = 10,
+    // [GetGlobal Slot]
+    GetGlobal = 11,
+    // [SetGlobal Slot]
+    // pops the top value into the global slot
+    SetGlobal = 12,
+    // [Cons]
+    // pops the cdr and then the car and pushes a new pair
+    Cons = 13,
+    // [Car]
+    Car = 14,
+    // [Cdr]
+    Cdr = 15,
+    // [IsNil]
+    IsNil = 16,
+    // [MakeClosure Pc Arity Captures]
+    // pops the captured values and pushes a closure over the function that
+    // starts at Pc
+    MakeClosure = 17,
+    // [GetCapture Index]
+    // pushes a value captured by the closure of the current frame
+    GetCapture = 18,
+    // [Call Argc]
+    // calls the closure beneath the Argc arguments on top of the stack
+    Call = 19,
+    // [Ret]
+    // pops the frame, leaving the top value in place of the closure
+    Ret = 20,
+    // [TailCall Argc]
+    // like Call, but replaces the current frame instead of pushing a new one
+    TailCall = 21,
+    // [Add], [Sub], [Mul]
+    // pop two ints and push the result, failing on overflow
+    Add = 22,
+    Sub = 23,
+    Mul = 24,
+    // [Lt], [Gt], [Eq]
+    // pop two ints and push the result of comparing them
+    Lt = 25,
+    Gt = 26,
+    Eq = 27,
+    // [JmpIfNotLt Pc], [JmpIfNotGt Pc], [JmpIfNotEq Pc]
+    // a comparison fused with the JmpIfNot that follows it
+    JmpIfNotLt = 28,
+    JmpIfNotGt = 29,
+    JmpIfNotEq = 30,
+    // [CallNative Index Argc]
+    // pops the Argc arguments of the native function at Index and pushes
+    // its result
+    CallNative = 31,
+    // [MemoGet Pc Table]
+    // at the entry of a memoized function: if the memo table has a result
+    // for the arguments of the current call, pushes it and jumps to Pc
+    MemoGet = 32,
+    // [MemoPut Table]
+    // records the top value as the result for the current call's arguments
+    MemoPut = 33,
 };
 
+std::string to_string(Opcode op);
+
+// number of four-byte operands following the opcode
+int operand_count(Opcode op);
+// is the first operand of |op| the position of an instruction, i.e. a jump
+// target or a function entry?
+bool has_target(Opcode op);
+
 void serialize_opcode(Opcode op, std::vector<char>* buf);
 absl::StatusOr<Opcode> deserialize_opcode(char ch);
 
+// A fixed-width instruction decoded from the serialized code. Operands are
+// resolved ahead of time: jump targets are indices into the decoded
+// instruction vector rather than byte offsets.
+struct Instr {
+    Opcode op;
+    // jump target for jumps, entry for MakeClosure, local slot
+    // for Get and Get2, constant pool index for Push, count for Slide, slot
+    // for GetGlobal and SetGlobal, capture index for GetCapture, argument
+    // count for Call and TailCall, function index for CallNative, memo table
+    // for MemoPut
+    int arg = 0;
+    // second local slot for Get2, arity for MakeClosure, argument count for
+    // CallNative, memo table for MemoGet
+    int arg2 = 0;
+    // capture count for MakeClosure
+    int arg3 = 0;
+};
+
+// net change in the number of values on the stack when |instr| runs. Ret
+// doesn't fall through, so it has none, and TailCall counts as a Call.
+int stack_effect(const Instr& instr);
+
+// decodes serialized code into instructions, validating opcodes, operands
+// and targets
+absl::StatusOr<std::vector<Instr>> decode(absl::Span<const char> code);
+
+// serializes decoded instructions, converting targets back to byte
+// offsets
+std::vector<char> encode(const std::vector<Instr>& instrs);
+
 #endif  // INSTR_H_
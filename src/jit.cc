@@ -0,0 +1,853 @@
+#include "jit.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JUNE_JIT 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define JUNE_JIT 0
+#endif
+
+// executable memory holding the code for one region
+struct Jit::Region {
+    void* mem = nullptr;
+    size_t size = 0;
+
+#if JUNE_JIT
+    ~Region() {
+        if (mem != nullptr) munmap(mem, size);
+    }
+#endif
+};
+
+namespace {
+
+#if JUNE_JIT
+
+enum Reg : uint8_t {
+    RAX = 0,
+    RCX = 1,
+    RDX = 2,
+    RSI = 6,
+    RDI = 7,
+    R8 = 8,
+    R9 = 9,
+    R10 = 10,
+    R11 = 11,
+};
+
+// the condition codes of jcc and setcc
+enum Cond : uint8_t {
+    kOverflow = 0x0,
+    kBelow = 0x2,
+    kAboveEqual = 0x3,
+    kEqual = 0x4,
+    kNotEqual = 0x5,
+    kBelowEqual = 0x6,
+    kAbove = 0x7,
+    kLess = 0xC,
+    kGreaterEqual = 0xD,
+    kLessEqual = 0xE,
+    kGreater = 0xF,
+};
+
+// Encodes the handful of x86-64 instructions the code generator needs. All
+// memory operands are [base + disp32].
+class Assembler final {
+public:
+    using Label = int;
+
+    Label new_label() {
+        labels_.push_back(-1);
+        return labels_.size() - 1;
+    }
+    void bind(Label label) { labels_[label] = bytes_.size(); }
+    int offset() const { return bytes_.size(); }
+
+    // dst = [base + disp]
+    void load(Reg dst, Reg base, int32_t disp) {
+        rex(true, dst, base);
+        byte(0x8B);
+        mem(dst, base, disp);
+    }
+    // [base + disp] = src
+    void store(Reg base, int32_t disp, Reg src) {
+        rex(true, src, base);
+        byte(0x89);
+        mem(src, base, disp);
+    }
+    // copies a whole TaggedValue through xmm register |xmm|
+    void load_value(int xmm, Reg base, int32_t disp) {
+        rex(false, xmm, base);
+        byte(0x0F);
+        byte(0x10);
+        mem(xmm, base, disp);
+    }
+    void store_value(Reg base, int32_t disp, int xmm) {
+        rex(false, xmm, base);
+        byte(0x0F);
+        byte(0x11);
+        mem(xmm, base, disp);
+    }
+    void lea(Reg dst, Reg base, int32_t disp) {
+        rex(true, dst, base);
+        byte(0x8D);
+        mem(dst, base, disp);
+    }
+    // dst = the 32 bits at [base + disp], zero-extended
+    void load32(Reg dst, Reg base, int32_t disp) {
+        rex(false, dst, base);
+        byte(0x8B);
+        mem(dst, base, disp);
+    }
+    void store32(Reg base, int32_t disp, Reg src) {
+        rex(false, src, base);
+        byte(0x89);
+        mem(src, base, disp);
+    }
+    void mov(Reg dst, Reg src) { op(0x89, dst, src); }
+    void mov(Reg dst, uint64_t imm) {
+        rex(true, 0, dst);
+        byte(0xB8 | (dst & 7));
+        for (int i = 0; i < 8; i++) byte(imm >> (8 * i));
+    }
+    // eax = imm
+    void mov_eax(int32_t imm) {
+        byte(0xB8);
+        imm32(imm);
+    }
+    void add(Reg dst, int32_t imm) {
+        rex(true, 0, dst);
+        byte(0x81);
+        byte(0xC0 | (dst & 7));
+        imm32(imm);
+    }
+    void sub(Reg dst, int32_t imm) {
+        rex(true, 0, dst);
+        byte(0x81);
+        byte(0xE8 | (dst & 7));
+        imm32(imm);
+    }
+    void add(Reg dst, Reg src) { op(0x01, dst, src); }
+    void sub(Reg dst, Reg src) { op(0x29, dst, src); }
+    void shl(Reg dst, uint8_t bits) { shift(4, dst, bits); }
+    void shr(Reg dst, uint8_t bits) { shift(5, dst, bits); }
+    // adds |imm| to the 32 bits at [base + disp]
+    void add32(Reg base, int32_t disp, int32_t imm) {
+        rex(false, 0, base);
+        byte(0x81);
+        mem(0, base, disp);
+        imm32(imm);
+    }
+    // dst op= [base + disp], setting the overflow flag
+    void add(Reg dst, Reg base, int32_t disp) { arith(0x03, dst, base, disp); }
+    void sub(Reg dst, Reg base, int32_t disp) { arith(0x2B, dst, base, disp); }
+    void imul(Reg dst, Reg base, int32_t disp) {
+        rex(true, dst, base);
+        byte(0x0F);
+        byte(0xAF);
+        mem(dst, base, disp);
+    }
+    // sets the flags for a - b
+    void cmp(Reg a, Reg b) {
+        rex(true, b, a);
+        byte(0x39);
+        byte(0xC0 | ((b & 7) << 3) | (a & 7));
+    }
+    // sets the flags for a - [base + disp]
+    void cmp(Reg a, Reg base, int32_t disp) { arith(0x3B, a, base, disp); }
+    // sets the flags for the low 32 bits of a - the 32 bits at [base + disp]
+    void cmp32(Reg a, Reg base, int32_t disp) {
+        rex(false, a, base);
+        byte(0x3B);
+        mem(a, base, disp);
+    }
+    // sets the flags for a & b
+    void test(Reg a, Reg b) { op(0x85, a, b); }
+    // sets the flags for the 32 bits at [base + disp] - imm
+    void cmp32(Reg base, int32_t disp, int32_t imm) {
+        rex(false, 0, base);
+        byte(0x81);
+        mem(7, base, disp);
+        imm32(imm);
+    }
+    void cmp8(Reg base, int32_t disp, uint8_t imm) {
+        rex(false, 0, base);
+        byte(0x80);
+        mem(7, base, disp);
+        byte(imm);
+    }
+    void store32(Reg base, int32_t disp, int32_t imm) {
+        rex(false, 0, base);
+        byte(0xC7);
+        mem(0, base, disp);
+        imm32(imm);
+    }
+    // stores the low byte of |src|, which must be rax or rcx
+    void store8(Reg base, int32_t disp, Reg src) {
+        rex(false, src, base);
+        byte(0x88);
+        mem(src, base, disp);
+    }
+    // sets the low byte of |dst|, which must be rax or rcx
+    void set(Cond cond, Reg dst) {
+        byte(0x0F);
+        byte(0x90 | cond);
+        byte(0xC0 | dst);
+    }
+    void jmp(Label label) {
+        byte(0xE9);
+        fixup(label);
+    }
+    void j(Cond cond, Label label) {
+        byte(0x0F);
+        byte(0x80 | cond);
+        fixup(label);
+    }
+    // jumps to the address in |target|
+    void jmp(Reg target) {
+        rex(false, 0, target);
+        byte(0xFF);
+        byte(0xE0 | (target & 7));
+    }
+    void ret() { byte(0xC3); }
+
+    // resolves the jumps and returns the code
+    std::vector<uint8_t> finish() {
+        for (auto [at, label] : fixups_) {
+            int32_t rel = labels_[label] - (at + 4);
+            std::memcpy(&bytes_[at], &rel, sizeof(rel));
+        }
+        return std::move(bytes_);
+    }
+
+private:
+    void byte(uint8_t b) { bytes_.push_back(b); }
+    void imm32(int32_t imm) {
+        for (int i = 0; i < 4; i++) byte(static_cast<uint32_t>(imm) >> (8 * i));
+    }
+    void rex(bool wide, int reg, int base) {
+        uint8_t rex = 0x40 | (wide << 3) | ((reg >> 3) << 2) | (base >> 3);
+        if (rex != 0x40) byte(rex);
+    }
+    void mem(int reg, Reg base, int32_t disp) {
+        byte(0x80 | ((reg & 7) << 3) | (base & 7));
+        imm32(disp);
+    }
+    void arith(uint8_t opcode, Reg dst, Reg base, int32_t disp) {
+        rex(true, dst, base);
+        byte(opcode);
+        mem(dst, base, disp);
+    }
+    // a 64-bit register-to-register instruction, dst = dst op src
+    void op(uint8_t opcode, Reg dst, Reg src) {
+        rex(true, src, dst);
+        byte(opcode);
+        byte(0xC0 | ((src & 7) << 3) | (dst & 7));
+    }
+    void shift(int ext, Reg dst, uint8_t bits) {
+        rex(true, 0, dst);
+        byte(0xC1);
+        byte(0xC0 | (ext << 3) | (dst & 7));
+        byte(bits);
+    }
+    void fixup(Label label) {
+        fixups_.emplace_back(bytes_.size(), label);
+        imm32(0);
+    }
+
+    std::vector<uint8_t> bytes_;
+    std::vector<int> labels_;
+    std::vector<std::pair<int, Label>> fixups_;
+};
+
+constexpr int32_t kValueSize = sizeof(TaggedValue);
+constexpr int32_t kPayload = offsetof(TaggedValue, as);
+static_assert(offsetof(TaggedValue, typ) == 0);
+// stack offsets and indices are scaled by shifting
+static_assert(kValueSize == 16 && sizeof(Frame) == 8);
+static_assert(sizeof(NativeCode) == 8);
+
+// offsets of the object fields that native code reads, which can't use
+// offsetof since the objects aren't standard-layout
+template <typename T, typename M>
+int32_t offset_of(M T::*field) {
+    T obj;
+    return reinterpret_cast<char*>(&(obj.*field)) -
+           reinterpret_cast<char*>(&obj);
+}
+
+// Translates the instructions reachable from one hot instruction. While
+// native code runs, the interpreter's state lives in registers:
+//
+//     rdi  the JitState
+//     rsi  the stack pointer
+//     rdx  the frame pointer
+//     r11  the bottom of the stack
+//     r9   the end of the stack's capacity
+//
+// and rax, rcx, r8, r10, xmm0 and xmm1 are scratch. Native code never
+// calls anything (calls in the program are jumps between native entry
+// points, which reload these from the JitState), so it only uses registers
+// the caller expects to be clobbered.
+class Codegen final {
+public:
+    Codegen(int root, absl::Span<const Instr> code,
+            absl::Span<const TaggedValue> constants)
+        : root_(root), code_(code), constants_(constants) {}
+
+    // returns the machine code and the offset in it of the native entry
+    // point for each instruction the interpreter can switch over at
+    std::vector<uint8_t> generate(std::vector<std::pair<int, int>>* entries);
+
+private:
+    using Label = Assembler::Label;
+
+    // finds the instructions to compile and the points where the
+    // interpreter can enter them
+    void discover();
+    void translate(int pc);
+
+    // side exits at |pc| unless there are |n| values on the stack
+    void need(int pc, int n);
+    // side exits at |pc| unless |n| more values fit on the stack
+    void room(int pc, int n);
+    // side exits at |pc| unless the value at |disp| from sp has type |typ|
+    void check_type(int pc, int32_t disp, Type typ);
+    // side exits at |pc| unless the frame slot |n| holds a value, leaving
+    // its address in |dst|
+    void slot(int pc, int n, Reg dst);
+    // the stub that returns to the interpreter at |pc|
+    Label exit(int pc);
+    // loads the native code for the instruction whose index is in ecx into
+    // r10, jumping to |missing| if it hasn't been compiled
+    void lookup_native(Label missing);
+    // switches to the native code in r10 with the current state
+    void jump_native();
+    // writes the state back to the JitState
+    void save();
+    // the code for the instruction at |dest|, jumped to from |pc|
+    Label target(int pc, int dest) {
+        auto it = labels_.find(dest);
+        return it == labels_.end() ? exit(pc) : it->second;
+    }
+
+    int root_;
+    absl::Span<const Instr> code_;
+    absl::Span<const TaggedValue> constants_;
+    std::vector<int> region_;
+    std::vector<int> entries_;
+    Assembler a_;
+    absl::flat_hash_map<int, Label> labels_;
+    std::vector<std::pair<int, Label>> exits_;
+    absl::flat_hash_map<int, Label> exit_labels_;
+    // returns to the interpreter at the instruction whose index is in ecx
+    Label dynamic_exit_ = a_.new_label();
+};
+
+// displacements are 32 bits, so offsets are only folded into instructions
+// for slots this close to sp or fp
+constexpr int kMaxSlot = 1 << 24;
+
+bool translatable(Opcode op) {
+    switch (op) {
+        case Opcode::Push:
+        case Opcode::Pop:
+        case Opcode::JmpIfNot:
+        case Opcode::Jmp:
+        case Opcode::Swap:
+        case Opcode::Get:
+        case Opcode::Slide:
+        case Opcode::Get2:
+        case Opcode::Car:
+        case Opcode::Cdr:
+        case Opcode::IsNil:
+        case Opcode::TailCall:
+        case Opcode::Add:
+        case Opcode::Sub:
+        case Opcode::Mul:
+        case Opcode::Lt:
+        case Opcode::Gt:
+        case Opcode::Eq:
+        case Opcode::JmpIfNotLt:
+        case Opcode::JmpIfNotGt:
+        case Opcode::JmpIfNotEq:
+        case Opcode::GetGlobal:
+        case Opcode::SetGlobal:
+        case Opcode::GetCapture:
+        case Opcode::Call:
+        case Opcode::Ret: return true;
+        default: return false;
+    }
+}
+
+void Codegen::discover() {
+    const int n = code_.size();
+    absl::flat_hash_set<int> seen = {root_};
+    std::vector<int> work = {root_};
+    entries_.push_back(root_);
+    auto visit = [&](int pc) {
+        if (pc >= 0 && pc < n && seen.insert(pc).second) work.push_back(pc);
+    };
+    while (!work.empty()) {
+        int pc = work.back();
+        work.pop_back();
+        region_.push_back(pc);
+        const Instr& instr = code_[pc];
+        switch (instr.op) {
+            case Opcode::Jmp: visit(instr.arg); break;
+            case Opcode::JmpIfNot:
+            case Opcode::JmpIfNotLt:
+            case Opcode::JmpIfNotGt:
+            case Opcode::JmpIfNotEq:
+                visit(instr.arg);
+                visit(pc + 1);
+                break;
+            case Opcode::Call:
+                // calls return here, from the interpreter or native code
+                visit(pc + 1);
+                if (pc + 1 < n) entries_.push_back(pc + 1);
+                break;
+            case Opcode::TailCall:
+            case Opcode::Ret:
+            case Opcode::Halt: break;
+            default:
+                if (translatable(instr.op)) {
+                    visit(pc + 1);
+                } else if (pc + 1 < n) {
+                    // the interpreter comes back here once it has run the
+                    // instruction
+                    if (seen.insert(pc + 1).second) work.push_back(pc + 1);
+                    entries_.push_back(pc + 1);
+                }
+                break;
+        }
+    }
+    std::sort(region_.begin(), region_.end());
+    std::sort(entries_.begin(), entries_.end());
+    entries_.erase(std::unique(entries_.begin(), entries_.end()),
+                   entries_.end());
+}
+
+std::vector<uint8_t> Codegen::generate(
+    std::vector<std::pair<int, int>>* entries) {
+    discover();
+    for (int pc : region_) labels_[pc] = a_.new_label();
+    for (int pc : region_) {
+        a_.bind(labels_[pc]);
+        translate(pc);
+    }
+
+    for (int pc : entries_) {
+        entries->emplace_back(pc, a_.offset());
+        a_.load(RSI, RDI, offsetof(JitState, sp));
+        a_.load(R11, RDI, offsetof(JitState, base));
+        a_.load(RDX, RDI, offsetof(JitState, fp));
+        a_.load(R9, RDI, offsetof(JitState, limit));
+        a_.jmp(labels_[pc]);
+    }
+    // exits can add more exits, so iterate by index
+    for (int i = 0; i < exits_.size(); i++) {
+        auto [pc, exit] = exits_[i];
+        a_.bind(exit);
+        save();
+        a_.mov_eax(pc);
+        a_.ret();
+    }
+    a_.bind(dynamic_exit_);
+    save();
+    a_.mov(RAX, RCX);
+    a_.ret();
+    return a_.finish();
+}
+
+Assembler::Label Codegen::exit(int pc) {
+    auto [it, inserted] = exit_labels_.try_emplace(pc);
+    if (inserted) {
+        it->second = a_.new_label();
+        exits_.emplace_back(pc, it->second);
+    }
+    return it->second;
+}
+
+void Codegen::lookup_native(Label missing) {
+    a_.cmp32(RCX, RDI, offsetof(JitState, num_native));
+    a_.j(kAboveEqual, missing);
+    a_.load(R10, RDI, offsetof(JitState, native));
+    a_.mov(RAX, RCX);
+    a_.shl(RAX, 3);
+    a_.add(R10, RAX);
+    a_.load(R10, R10, 0);
+    a_.test(R10, R10);
+    a_.j(kEqual, missing);
+}
+
+void Codegen::jump_native() {
+    save();
+    a_.jmp(R10);
+}
+
+void Codegen::save() {
+    a_.store(RDI, offsetof(JitState, sp), RSI);
+    a_.store(RDI, offsetof(JitState, fp), RDX);
+}
+
+void Codegen::need(int pc, int n) {
+    a_.lea(RCX, R11, n * kValueSize);
+    a_.cmp(RSI, RCX);
+    a_.j(kBelow, exit(pc));
+}
+
+void Codegen::room(int pc, int n) {
+    a_.lea(RCX, RSI, n * kValueSize);
+    a_.cmp(RCX, R9);
+    a_.j(kAbove, exit(pc));
+}
+
+void Codegen::check_type(int pc, int32_t disp, Type typ) {
+    a_.cmp32(RSI, disp, static_cast<int32_t>(typ));
+    a_.j(kNotEqual, exit(pc));
+}
+
+void Codegen::slot(int pc, int n, Reg dst) {
+    a_.lea(dst, RDX, n * kValueSize);
+    a_.cmp(dst, RSI);
+    a_.j(kAboveEqual, exit(pc));
+}
+
+void Codegen::translate(int pc) {
+    const Instr& instr = code_[pc];
+    // the top of the stack and the value below it
+    constexpr int32_t kTop = -kValueSize, kSecond = -2 * kValueSize;
+    auto int_operands = [&] {
+        need(pc, 2);
+        check_type(pc, kSecond, Type::Int);
+        check_type(pc, kTop, Type::Int);
+        a_.load(RAX, RSI, kSecond + kPayload);
+    };
+    auto bool_result = [&](Cond cond, int32_t disp) {
+        a_.set(cond, RAX);
+        a_.store32(RSI, disp, static_cast<int32_t>(Type::Bool));
+        a_.store8(RSI, disp + kPayload, RAX);
+    };
+
+    switch (instr.op) {
+        case Opcode::Push: {
+            if (instr.arg < 0 || instr.arg >= constants_.size()) break;
+            // constants never change, so their bytes are baked in
+            uint64_t words[2];
+            static_assert(sizeof(words) == sizeof(TaggedValue));
+            std::memcpy(words, &constants_[instr.arg], sizeof(words));
+            room(pc, 1);
+            a_.mov(RAX, words[0]);
+            a_.store(RSI, 0, RAX);
+            a_.mov(RAX, words[1]);
+            a_.store(RSI, 8, RAX);
+            a_.add(RSI, kValueSize);
+            return;
+        }
+
+        case Opcode::Pop:
+            need(pc, 1);
+            a_.sub(RSI, kValueSize);
+            return;
+
+        case Opcode::Swap:
+            need(pc, 2);
+            a_.load_value(0, RSI, kTop);
+            a_.load_value(1, RSI, kSecond);
+            a_.store_value(RSI, kSecond, 0);
+            a_.store_value(RSI, kTop, 1);
+            return;
+
+        case Opcode::Get:
+            if (instr.arg < 0 || instr.arg >= kMaxSlot) break;
+            slot(pc, instr.arg, RAX);
+            room(pc, 1);
+            a_.load_value(0, RAX, 0);
+            a_.store_value(RSI, 0, 0);
+            a_.add(RSI, kValueSize);
+            return;
+
+        case Opcode::Get2:
+            if (instr.arg < 0 || instr.arg >= kMaxSlot || instr.arg2 < 0 ||
+                instr.arg2 >= kMaxSlot) {
+                break;
+            }
+            // the second slot can be the one the first value goes to
+            slot(pc, instr.arg, RAX);
+            a_.lea(R10, RDX, instr.arg2 * kValueSize);
+            a_.cmp(R10, RSI);
+            a_.j(kAbove, exit(pc));
+            room(pc, 2);
+            a_.load_value(0, RAX, 0);
+            a_.store_value(RSI, 0, 0);
+            a_.load_value(1, R10, 0);
+            a_.store_value(RSI, kValueSize, 1);
+            a_.add(RSI, 2 * kValueSize);
+            return;
+
+        case Opcode::Slide:
+            if (instr.arg < 0 || instr.arg >= kMaxSlot) break;
+            need(pc, instr.arg + 1);
+            a_.load_value(0, RSI, kTop);
+            a_.store_value(RSI, -(instr.arg + 1) * kValueSize, 0);
+            a_.sub(RSI, instr.arg * kValueSize);
+            return;
+
+        case Opcode::Jmp: a_.jmp(target(pc, instr.arg)); return;
+
+        case Opcode::JmpIfNot:
+            need(pc, 1);
+            check_type(pc, kTop, Type::Bool);
+            a_.sub(RSI, kValueSize);
+            a_.cmp8(RSI, kPayload, 0);
+            a_.j(kEqual, target(pc, instr.arg));
+            return;
+
+        case Opcode::IsNil:
+            need(pc, 1);
+            a_.cmp32(RSI, kTop, static_cast<int32_t>(Type::Nil));
+            bool_result(kEqual, kTop);
+            return;
+
+        case Opcode::Car:
+        case Opcode::Cdr: {
+            need(pc, 1);
+            check_type(pc, kTop, Type::Pair);
+            a_.load(RAX, RSI, kTop + kPayload);
+            int32_t field = instr.op == Opcode::Car ? offset_of(&Pair::car)
+                                                    : offset_of(&Pair::cdr);
+            a_.load_value(0, RAX, field);
+            a_.store_value(RSI, kTop, 0);
+            return;
+        }
+
+        case Opcode::Add:
+        case Opcode::Sub:
+        case Opcode::Mul:
+            int_operands();
+            if (instr.op == Opcode::Add) a_.add(RAX, RSI, kTop + kPayload);
+            else if (instr.op == Opcode::Sub) a_.sub(RAX, RSI, kTop + kPayload);
+            else a_.imul(RAX, RSI, kTop + kPayload);
+            // the interpreter promotes to a bignum
+            a_.j(kOverflow, exit(pc));
+            a_.store(RSI, kSecond + kPayload, RAX);
+            a_.sub(RSI, kValueSize);
+            return;
+
+        case Opcode::Lt:
+        case Opcode::Gt:
+        case Opcode::Eq: {
+            int_operands();
+            a_.cmp(RAX, RSI, kTop + kPayload);
+            Cond cond = instr.op == Opcode::Lt   ? kLess
+                        : instr.op == Opcode::Gt ? kGreater
+                                                 : kEqual;
+            bool_result(cond, kSecond);
+            a_.sub(RSI, kValueSize);
+            return;
+        }
+
+        case Opcode::JmpIfNotLt:
+        case Opcode::JmpIfNotGt:
+        case Opcode::JmpIfNotEq: {
+            int_operands();
+            a_.cmp(RAX, RSI, kTop + kPayload);
+            // lea pops the operands without touching the flags
+            a_.lea(RSI, RSI, kSecond);
+            Cond cond = instr.op == Opcode::JmpIfNotLt   ? kGreaterEqual
+                        : instr.op == Opcode::JmpIfNotGt ? kLessEqual
+                                                         : kNotEqual;
+            a_.j(cond, target(pc, instr.arg));
+            return;
+        }
+
+        case Opcode::GetGlobal: {
+            if (instr.arg < 0 || instr.arg >= kMaxSlot) break;
+            const int32_t global = instr.arg * kValueSize;
+            room(pc, 1);
+            a_.load(RAX, RDI, offsetof(JitState, globals));
+            a_.cmp32(RAX, global, static_cast<int32_t>(kUndefined));
+            a_.j(kEqual, exit(pc));
+            a_.load_value(0, RAX, global);
+            a_.store_value(RSI, 0, 0);
+            a_.add(RSI, kValueSize);
+            return;
+        }
+
+        case Opcode::SetGlobal:
+            if (instr.arg < 0 || instr.arg >= kMaxSlot) break;
+            need(pc, 1);
+            a_.load(RAX, RDI, offsetof(JitState, globals));
+            a_.load_value(0, RSI, kTop);
+            a_.store_value(RAX, instr.arg * kValueSize, 0);
+            a_.sub(RSI, kValueSize);
+            return;
+
+        case Opcode::GetCapture:
+            if (instr.arg < 0 || instr.arg >= kMaxSlot) break;
+            // the closure is just below the frame
+            a_.cmp(RDX, R11);
+            a_.j(kEqual, exit(pc));
+            a_.cmp32(RDX, kTop, static_cast<int32_t>(Type::Closure));
+            a_.j(kNotEqual, exit(pc));
+            a_.load(RAX, RDX, kTop + kPayload);
+            a_.cmp32(RAX, offset_of(&Closure::num_captures), instr.arg);
+            a_.j(kLessEqual, exit(pc));
+            room(pc, 1);
+            a_.load_value(0, RAX, sizeof(Closure) + instr.arg * kValueSize);
+            a_.store_value(RSI, 0, 0);
+            a_.add(RSI, kValueSize);
+            return;
+
+        case Opcode::Call:
+        case Opcode::TailCall: {
+            const int argc = instr.arg;
+            if (argc < 0 || argc >= kMaxSlot) break;
+            if (instr.op == Opcode::Call && pc + 1 >= code_.size()) break;
+            const int32_t callee = -(argc + 1) * kValueSize;
+            need(pc, argc + 1);
+            if (instr.op == Opcode::TailCall) {
+                // at the top level there's no frame to reuse
+                a_.cmp(RDX, R11);
+                a_.j(kEqual, exit(pc));
+            }
+            check_type(pc, callee, Type::Closure);
+            a_.load(RAX, RSI, callee + kPayload);
+            a_.cmp32(RAX, offset_of(&Closure::arity), argc);
+            a_.j(kNotEqual, exit(pc));
+            // calls to code that isn't compiled go through the interpreter,
+            // which counts them towards compiling it
+            Label self = a_.new_label();
+            if (instr.op == Opcode::TailCall) {
+                // self tail calls jump straight back to the root, which
+                // leaves r10 null
+                a_.mov(R10, 0);
+                a_.cmp32(RAX, offset_of(&Closure::entry), root_);
+                a_.j(kEqual, self);
+            }
+            a_.load32(RCX, RAX, offset_of(&Closure::entry));
+            lookup_native(exit(pc));
+            a_.bind(self);
+
+            if (instr.op == Opcode::Call) {
+                a_.load32(RAX, RDI, offsetof(JitState, num_frames));
+                a_.cmp32(RAX, RDI, offsetof(JitState, max_frames));
+                a_.j(kAboveEqual, exit(pc));
+                // push Frame{.pc = pc + 1, .fp = fp}
+                a_.load(R8, RDI, offsetof(JitState, frames));
+                a_.shl(RAX, 3);
+                a_.add(R8, RAX);
+                a_.store32(R8, offsetof(Frame, pc), pc + 1);
+                a_.mov(RCX, RDX);
+                a_.sub(RCX, R11);
+                a_.shr(RCX, 4);
+                a_.store32(R8, offsetof(Frame, fp), RCX);
+                a_.add32(RDI, offsetof(JitState, num_frames), 1);
+                a_.lea(RDX, RSI, -argc * kValueSize);
+            } else {
+                // move the closure and arguments down over the current
+                // frame
+                for (int i = 0; i <= argc; i++) {
+                    a_.load_value(0, RSI, callee + i * kValueSize);
+                    a_.store_value(RDX, (i - 1) * kValueSize, 0);
+                }
+                a_.lea(RSI, RDX, argc * kValueSize);
+                a_.test(R10, R10);
+                a_.j(kEqual, target(pc, root_));
+            }
+            jump_native();
+            return;
+        }
+
+        case Opcode::Ret:
+            a_.cmp32(RDI, offsetof(JitState, num_frames), 0);
+            a_.j(kEqual, exit(pc));
+            a_.cmp(RSI, RDX);
+            a_.j(kBelowEqual, exit(pc));
+            // the result replaces the closure
+            a_.load_value(0, RSI, kTop);
+            a_.store_value(RDX, kTop, 0);
+            a_.mov(RSI, RDX);
+            // pop the frame, leaving its pc in ecx
+            a_.add32(RDI, offsetof(JitState, num_frames), -1);
+            a_.load32(RAX, RDI, offsetof(JitState, num_frames));
+            a_.load(R8, RDI, offsetof(JitState, frames));
+            a_.shl(RAX, 3);
+            a_.add(R8, RAX);
+            a_.load32(RCX, R8, offsetof(Frame, pc));
+            a_.load32(RAX, R8, offsetof(Frame, fp));
+            a_.shl(RAX, 4);
+            a_.mov(RDX, R11);
+            a_.add(RDX, RAX);
+            lookup_native(dynamic_exit_);
+            jump_native();
+            return;
+
+        default: break;
+    }
+    // everything else is left to the interpreter
+    a_.jmp(exit(pc));
+}
+
+#endif  // JUNE_JIT
+
+}  // namespace
+
+bool Jit::supported() { return JUNE_JIT; }
+
+Jit::Jit() = default;
+Jit::~Jit() = default;
+
+NativeCode Jit::enter(int pc, absl::Span<const Instr> code,
+                      absl::Span<const TaggedValue> constants) {
+    if (pc >= native_.size()) {
+        native_.resize(code.size());
+        hotness_.resize(code.size());
+    }
+    if (native_[pc] == nullptr) {
+        if (++hotness_[pc] < kHotThreshold) return nullptr;
+        hotness_[pc] = 0;
+        compile(pc, code, constants);
+        if (native_[pc] == nullptr) return nullptr;
+    }
+    stats_.entries++;
+    return native_[pc];
+}
+
+void Jit::compile(int root, absl::Span<const Instr> code,
+                  absl::Span<const TaggedValue> constants) {
+#if JUNE_JIT
+    std::vector<std::pair<int, int>> entries;
+    std::vector<uint8_t> bytes =
+        Codegen(root, code, constants).generate(&entries);
+
+    // write the code and then make it executable, but never both at once
+    const size_t page = sysconf(_SC_PAGESIZE);
+    auto region = std::make_unique<Region>();
+    region->size = (bytes.size() + page - 1) / page * page;
+    void* mem = mmap(nullptr, region->size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return;
+    region->mem = mem;
+    std::memcpy(mem, bytes.data(), bytes.size());
+    if (mprotect(mem, region->size, PROT_READ | PROT_EXEC) != 0) return;
+
+    for (auto [pc, offset] : entries) {
+        if (native_[pc] != nullptr) continue;
+        native_[pc] = reinterpret_cast<NativeCode>(static_cast<char*>(mem) +
+                                                   offset);
+    }
+    regions_.push_back(std::move(region));
+    stats_.regions++;
+    stats_.native_bytes += bytes.size();
+#endif
+}
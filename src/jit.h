@@ -0,0 +1,107 @@
+#ifndef JIT_H_
+#define JIT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "instr.h"
+#include "value.h"
+
+// The record of a call, which the interpreter and native code both push
+// and pop.
+struct Frame {
+    // where to continue in the caller
+    int pc;
+    // the caller's frame pointer
+    int fp;
+};
+
+struct JitState;
+
+// Runs from the instruction it was compiled for until it reaches one that
+// it can't handle, and returns that instruction's index with |state|
+// updated. The interpreter then carries on from there.
+using NativeCode = int (*)(JitState* state);
+
+// The interpreter state that native code reads and updates. Native code
+// works directly on the vm's value stack, call frames and globals, so this
+// is all it takes to move between the two.
+struct JitState {
+    TaggedValue* sp;
+    TaggedValue* base;
+    // base + the vm's frame pointer
+    TaggedValue* fp;
+    TaggedValue* limit;
+    // indexed by slot, with kUndefined for slots that haven't been defined
+    TaggedValue* globals;
+    // native code pushes frames until there are max_frames of them and
+    // then leaves the call to the interpreter
+    Frame* frames;
+    int32_t num_frames;
+    int32_t max_frames;
+    // the compiled code for each instruction, or null, which native calls
+    // and returns use to stay in native code
+    const NativeCode* native;
+    int32_t num_native;
+};
+
+struct JitStats {
+    // number of regions compiled to native code
+    int64_t regions = 0;
+    int64_t native_bytes = 0;
+    // number of times the interpreter switched to native code
+    int64_t entries = 0;
+};
+
+// A baseline JIT for x86-64 Linux. Once the interpreter has entered a
+// function (or returned to a call site) kHotThreshold times, the code
+// reachable from there is translated one instruction at a time into
+// machine code that does what the interpreter would: Push, Pop, Get, Swap,
+// Slide, the jumps, the integer opcodes on fixnums, Car, Cdr, IsNil,
+// globals, captures, and calls and returns between compiled code.
+// Everything else, and every slow path (type errors, overflow, stack or
+// frame growth, calls into code that isn't compiled yet), is a side exit
+// back to the interpreter at the current instruction, so the interpreter
+// stays the only place that allocates, reports errors or handles bignums.
+//
+// Compiled code only depends on its own instructions and constants, which
+// never change once loaded, so it stays valid for the life of the vm.
+class Jit final {
+public:
+    static constexpr int kHotThreshold = 16;
+
+    // can native code be generated on this platform?
+    static bool supported();
+
+    Jit();
+    ~Jit();
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    // Returns native code to run from |pc|, compiling it if |pc| just
+    // became hot, or nullptr to keep interpreting.
+    NativeCode enter(int pc, absl::Span<const Instr> code,
+                     absl::Span<const TaggedValue> constants);
+
+    // the compiled code for each instruction so far, or null
+    absl::Span<const NativeCode> native() const { return native_; }
+    const JitStats& stats() const { return stats_; }
+
+private:
+    struct Region;
+
+    // compiles the instructions reachable from |root|
+    void compile(int root, absl::Span<const Instr> code,
+                 absl::Span<const TaggedValue> constants);
+
+    // number of times each instruction has been entered
+    std::vector<int> hotness_;
+    std::vector<NativeCode> native_;
+    std::vector<std::unique_ptr<Region>> regions_;
+    JitStats stats_;
+};
+
+#endif  // JIT_H_
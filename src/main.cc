@@ -1,4 +1,6 @@
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <vector>
@@ -8,12 +10,36 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_format.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "cgen.h"
+#include "chunk.h"
 #include "evaluator.h"
+#include "mapped_file.h"
+#include "parallel.h"
 
 ABSL_FLAG(bool, log_tokens, false, "print tokens after scanning");
 ABSL_FLAG(bool, log_ast, false, "print ast after parsing");
 ABSL_FLAG(bool, log_code, false, "print bytecode after compiling");
 ABSL_FLAG(bool, log_vm, false, "print instructions when executing");
+ABSL_FLAG(bool, optimize, true, "fold constants and optimize bytecode");
+ABSL_FLAG(bool, compile, false, "compile to a bytecode file without running");
+ABSL_FLAG(bool, emit_c, false, "compile to a standalone C program");
+ABSL_FLAG(std::string, o, "", "output path for --compile and --emit_c");
+ABSL_FLAG(bool, exec, false, "run a bytecode file produced by --compile");
+ABSL_FLAG(bool, gc_stats, false, "print heap statistics when done");
+ABSL_FLAG(bool, jit, false,
+          "compile hot functions to native code (x86-64 linux only)");
+ABSL_FLAG(int, jobs, 1, "number of threads to run several files on");
+ABSL_FLAG(bool, memo_stats, false,
+          "print hit and miss counts of define-memo functions when done, "
+          "with calls whose arguments can't be cached counted separately");
+ABSL_FLAG(int, memo_capacity, VM::kDefaultMemoCapacity,
+          "most results each define-memo function caches");
+
+constexpr char kUsage[] =
+    "usage: june [<file>... [--jobs N] | --compile <file> -o <out> |\n"
+    "             --emit_c <file> -o <out> | --exec <file>]";
 
 Evaluator build_evaluator(std::function<void(absl::Status)> handler,
                           bool interactive) {
@@ -23,6 +49,9 @@ Evaluator build_evaluator(std::function<void(absl::Status)> handler,
     evaluator.set_log_ast(absl::GetFlag(FLAGS_log_ast));
     evaluator.set_log_code(absl::GetFlag(FLAGS_log_code));
     evaluator.set_log_vm(absl::GetFlag(FLAGS_log_vm));
+    evaluator.set_optimize(absl::GetFlag(FLAGS_optimize));
+    evaluator.set_jit(absl::GetFlag(FLAGS_jit));
+    evaluator.set_memo_capacity(absl::GetFlag(FLAGS_memo_capacity));
     return evaluator;
 }
 
@@ -31,24 +60,129 @@ void die(absl::Status status) {
     exit(EXIT_FAILURE);
 }
 
-absl::StatusOr<std::string> read_file(std::string_view path) {
-    std::ifstream is(path);
-    if (!is) {
-        die(absl::UnavailableError(
-            absl::StrFormat("can't open %s: %s", path, strerror(errno))));
+// the statistics that were asked for, one line each, starting with |prefix|
+std::string stats(const Evaluator& eval, std::string_view prefix = "") {
+    std::string lines;
+    if (absl::GetFlag(FLAGS_gc_stats)) {
+        const auto& heap = eval.heap_stats();
+        absl::StrAppendFormat(
+            &lines,
+            "%sgc: %d bytes allocated, %d collections, %d bytes live, "
+            "%s total pause, %s max pause\n",
+            prefix, heap.bytes_allocated, heap.collections, heap.bytes_live,
+            absl::FormatDuration(heap.total_pause),
+            absl::FormatDuration(heap.max_pause));
     }
-    // https://stackoverflow.com/a/2602258
-    std::stringstream buf;
-    buf << is.rdbuf();
-    std::string text = buf.str();
-    return text;
+    if (absl::GetFlag(FLAGS_memo_stats)) {
+        auto memo = eval.memo_stats();
+        // calls with arguments that can't be cached are neither hits nor
+        // misses
+        absl::StrAppendFormat(
+            &lines,
+            "%smemo: %d hits, %d misses, %d evictions, %d uncacheable calls\n",
+            prefix, memo.hits, memo.misses, memo.evictions, memo.uncacheable);
+    }
+    return lines;
+}
+
+void print_stats(const Evaluator& eval) {
+    absl::FPrintF(stderr, "%s", stats(eval));
+}
+
+// the text of a script, which is read in place from the mapping
+std::string_view source(const MappedFile& file) {
+    return std::string_view(file.data().data(), file.data().size());
 }
 
 void run(std::string_view path) {
-    auto text = read_file(path);
-    if (!text.ok()) die(text.status());
+    auto file = MappedFile::open(std::string(path));
+    if (!file.ok()) die(file.status());
     auto eval = build_evaluator(die, false);
-    eval.evaluate(text.value());
+    eval.run_script(source(**file));
+    print_stats(eval);
+}
+
+// Runs each of |paths| in its own evaluator on |jobs| threads. Once all of
+// them have finished, prints what each one printed in the order given,
+// with errors prefixed by the path, and fails if any of them failed.
+void run_batch(absl::Span<char* const> paths, int jobs) {
+    struct Result {
+        std::ostringstream out;
+        std::string errors;
+        bool ok = true;
+    };
+    std::vector<Result> results(paths.size());
+    std::vector<std::function<void()>> tasks;
+    for (int i = 0; i < paths.size(); i++) {
+        std::string_view path = paths[i];
+        Result& result = results[i];
+        tasks.push_back([path, &result] {
+            auto fail = [path, &result](absl::Status status) {
+                result.ok = false;
+                absl::StrAppendFormat(&result.errors, "%s: %s\n", path,
+                                      status.message());
+            };
+            auto file = MappedFile::open(std::string(path));
+            if (!file.ok()) return fail(file.status());
+            auto eval = build_evaluator(fail, false);
+            eval.set_output(&result.out);
+            eval.run_script(source(**file));
+            result.errors += stats(eval, absl::StrFormat("%s: ", path));
+        });
+    }
+    run_parallel(jobs, std::move(tasks));
+
+    bool ok = true;
+    for (const auto& result : results) {
+        std::cout << result.out.str();
+        std::cerr << result.errors;
+        ok = ok && result.ok;
+    }
+    std::cout.flush();
+    exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+void write_file(std::string_view path, absl::Span<const char> bytes) {
+    std::ofstream os{std::string(path), std::ios::binary};
+    os.write(bytes.data(), bytes.size());
+    if (!os) {
+        die(absl::UnavailableError(
+            absl::StrFormat("can't write %s: %s", path, strerror(errno))));
+    }
+}
+
+void compile(std::string_view path) {
+    std::string out = absl::GetFlag(FLAGS_o);
+    if (out.empty()) die(absl::InvalidArgumentError(kUsage));
+    auto file = MappedFile::open(std::string(path));
+    if (!file.ok()) die(file.status());
+    auto eval = build_evaluator(die, false);
+    auto chunk = eval.compile(source(**file));
+    if (!chunk.ok()) die(chunk.status());
+    write_file(out, serialize_chunk(*chunk));
+}
+
+void compile_to_c(std::string_view path) {
+    std::string out = absl::GetFlag(FLAGS_o);
+    if (out.empty()) die(absl::InvalidArgumentError(kUsage));
+    auto file = MappedFile::open(std::string(path));
+    if (!file.ok()) die(file.status());
+    auto eval = build_evaluator(die, false);
+    auto chunk = eval.compile(source(**file));
+    if (!chunk.ok()) die(chunk.status());
+    auto program = emit_c(chunk->view());
+    if (!program.ok()) die(program.status());
+    write_file(out, *program);
+}
+
+void exec(std::string_view path) {
+    auto file = MappedFile::open(std::string(path));
+    if (!file.ok()) die(file.status());
+    auto chunk = deserialize_chunk((*file)->data());
+    if (!chunk.ok()) die(chunk.status());
+    auto eval = build_evaluator(die, false);
+    eval.execute(*chunk);
+    print_stats(eval);
 }
 
 void repl() {
@@ -65,11 +199,29 @@ void repl() {
         eval.evaluate(line);
     }
     std::cout << std::endl;
+    print_stats(eval);
 }
 
 int main(int argc, char* argv[]) {
     auto args = absl::ParseCommandLine(argc, argv);
-    if (args.size() == 1) repl();
+    bool compile_only = absl::GetFlag(FLAGS_compile);
+    bool exec_only = absl::GetFlag(FLAGS_exec);
+    bool c_only = absl::GetFlag(FLAGS_emit_c);
+    bool run_only = !compile_only && !exec_only && !c_only;
+    auto files = absl::MakeConstSpan(args).subspan(1);
+    int jobs = absl::GetFlag(FLAGS_jobs);
+    if (compile_only + exec_only + c_only > 1 || jobs < 1 ||
+        absl::GetFlag(FLAGS_memo_capacity) < 0) {
+        die(absl::InvalidArgumentError(kUsage));
+    }
+    if (absl::GetFlag(FLAGS_jit) && !Jit::supported()) {
+        absl::FPrintF(stderr, "--jit isn't supported here, ignoring\n");
+    }
+    if (args.size() == 1 && run_only) repl();
+    else if (args.size() == 2 && compile_only) compile(args[1]);
+    else if (args.size() == 2 && c_only) compile_to_c(args[1]);
+    else if (args.size() == 2 && exec_only) exec(args[1]);
     else if (args.size() == 2) run(args[1]);
-    else die(absl::InvalidArgumentError("usage: june <file>"));
+    else if (args.size() > 2 && run_only) run_batch(files, jobs);
+    else die(absl::InvalidArgumentError(kUsage));
 }
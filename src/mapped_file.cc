@@ -0,0 +1,61 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include "absl/strings/str_format.h"
+
+namespace {
+absl::Status unavailable(const std::string& path) {
+    return absl::UnavailableError(
+        absl::StrFormat("can't open %s: %s", path, strerror(errno)));
+}
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<MappedFile>> MappedFile::open(
+    const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return unavailable(path);
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        auto status = unavailable(path);
+        close(fd);
+        return status;
+    }
+    // Pipes and devices would look empty rather than fail to map, and
+    // files in /proc claim to be empty, so those are read instead.
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        size_t size = st.st_size;
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            close(fd);
+            return std::unique_ptr<MappedFile>(
+                new MappedFile(static_cast<const char*>(data), size));
+        }
+    }
+    std::string contents;
+    char buf[1 << 16];
+    while (true) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            auto status = unavailable(path);
+            close(fd);
+            return status;
+        }
+        if (n == 0) break;
+        contents.append(buf, n);
+    }
+    close(fd);
+    return std::unique_ptr<MappedFile>(new MappedFile(std::move(contents)));
+}
+
+MappedFile::~MappedFile() {
+    if (mapped_) munmap(const_cast<char*>(data_), size_);
+}
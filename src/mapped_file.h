@@ -0,0 +1,40 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+
+// The contents of an entire file. Regular files are mapped read-only, and
+// the mapping is released when the MappedFile is destroyed; anything that
+// can't be mapped, like a pipe or a FIFO, is read into memory instead.
+class MappedFile final {
+public:
+    static absl::StatusOr<std::unique_ptr<MappedFile>> open(
+        const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    absl::Span<const char> data() const { return {data_, size_}; }
+
+private:
+    MappedFile(const char* data, size_t size) : data_(data), size_(size) {}
+    explicit MappedFile(std::string contents)
+        : contents_(std::move(contents)),
+          data_(contents_.data()),
+          size_(contents_.size()),
+          mapped_(false) {}
+
+    // what was read, when the file isn't mapped
+    std::string contents_;
+    const char* data_;
+    size_t size_;
+    bool mapped_ = true;
+};
+
+#endif  // MAPPED_FILE_H_
@@ -0,0 +1,62 @@
+#include "memo.h"
+
+bool MemoCache::make_key(absl::Span<const TaggedValue> args, Key* key) {
+    for (const TaggedValue& arg : args) {
+        switch (arg.typ) {
+            case Type::Int: key->emplace_back(arg.typ, arg.as.i); break;
+            // the rest of the payload is undefined
+            case Type::Bool: key->emplace_back(arg.typ, arg.as.b); break;
+            case Type::Nil: key->emplace_back(arg.typ, 0); break;
+            default: return false;
+        }
+    }
+    return true;
+}
+
+const TaggedValue* MemoCache::find(absl::Span<const TaggedValue> args) {
+    Key key;
+    if (!make_key(args, &key)) {
+        stats_.uncacheable++;
+        return nullptr;
+    }
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        stats_.misses++;
+        return nullptr;
+    }
+    stats_.hits++;
+    used_[it->second] = true;
+    return &results_[it->second];
+}
+
+void MemoCache::insert(absl::Span<const TaggedValue> args,
+                       TaggedValue result) {
+    Key key;
+    if (capacity_ <= 0 || !make_key(args, &key)) return;
+    auto [it, inserted] = index_.try_emplace(key, results_.size());
+    if (!inserted) {
+        // a recursive call with the same arguments finished first
+        results_[it->second] = result;
+        return;
+    }
+    if (results_.size() < capacity_) {
+        keys_.push_back(std::move(key));
+        results_.push_back(result);
+        used_.push_back(false);
+        return;
+    }
+
+    // give each used entry a second chance until the hand finds one that
+    // wasn't, and replace that one
+    while (used_[hand_]) {
+        used_[hand_] = false;
+        hand_ = (hand_ + 1) % capacity_;
+    }
+    index_.erase(keys_[hand_]);
+    stats_.evictions++;
+    it = index_.find(key);
+    it->second = hand_;
+    keys_[hand_] = std::move(key);
+    results_[hand_] = result;
+    hand_ = (hand_ + 1) % capacity_;
+}
@@ -0,0 +1,64 @@
+#ifndef MEMO_H_
+#define MEMO_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/types/span.h"
+#include "value.h"
+
+// Hits and misses only count calls that could be cached. Calls with an
+// argument that can't be a key are counted as uncacheable instead, since
+// they always run the function whatever the cache holds.
+struct MemoStats {
+    int64_t hits = 0;
+    int64_t misses = 0;
+    // entries dropped to make room for new ones
+    int64_t evictions = 0;
+    int64_t uncacheable = 0;
+};
+
+// The results of one memoized function, keyed by the arguments it was
+// called with. Only calls whose arguments are all fixnums, booleans or nil
+// are cached: heap objects move when they are collected, so they can't be
+// hashed by address, and comparing them by value could cost as much as the
+// call. Results can be anything, and are roots for the collector.
+//
+// The cache holds at most |capacity| results. Once it's full, each new
+// result replaces one that hasn't been looked up since the clock hand last
+// passed it, which approximates evicting the least recently used.
+class MemoCache final {
+public:
+    explicit MemoCache(int capacity) : capacity_(capacity) {}
+
+    // the result cached for |args|, if there is one, counting a hit, a
+    // miss or an uncacheable call
+    const TaggedValue* find(absl::Span<const TaggedValue> args);
+    // caches |result| for |args| if they can be a key
+    void insert(absl::Span<const TaggedValue> args, TaggedValue result);
+
+    // the cached results, for the collector to update
+    absl::Span<TaggedValue> results() { return absl::MakeSpan(results_); }
+    int size() const { return results_.size(); }
+    const MemoStats& stats() const { return stats_; }
+
+private:
+    // the type and payload of each argument
+    using Key = absl::InlinedVector<std::pair<Type, int64_t>, 3>;
+    static bool make_key(absl::Span<const TaggedValue> args, Key* key);
+
+    int capacity_;
+    absl::flat_hash_map<Key, int> index_;
+    // entry i is keys_[i] -> results_[i], and used_[i] is set when it's
+    // looked up
+    std::vector<Key> keys_;
+    std::vector<TaggedValue> results_;
+    std::vector<bool> used_;
+    int hand_ = 0;
+    MemoStats stats_;
+};
+
+#endif  // MEMO_H_
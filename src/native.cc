@@ -0,0 +1,24 @@
+#include "native.h"
+
+#include "ast.h"
+
+std::optional<int> Natives::lookup(std::string_view name) const {
+    auto it = index_.find(name);
+    if (it == index_.end()) return std::nullopt;
+    return it->second;
+}
+
+absl::Status Natives::add(NativeFunction function) {
+    if (lookup_builtin(function.name).has_value()) {
+        return absl::InvalidArgumentError(
+            absl::StrFormat("%s is a builtin", function.name));
+    }
+    auto [it, inserted] =
+        index_.try_emplace(function.name, static_cast<int>(functions_.size()));
+    if (!inserted) {
+        return absl::AlreadyExistsError(
+            absl::StrFormat("%s is already defined", function.name));
+    }
+    functions_.push_back(std::move(function));
+    return absl::OkStatus();
+}
@@ -0,0 +1,170 @@
+#ifndef NATIVE_H_
+#define NATIVE_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/types/span.h"
+#include "value.h"
+
+// Unpacks the arguments of a native function from the vm's stack, calls it
+// and writes its result over the first argument. |args| has room for the
+// result even when the function takes no arguments.
+using NativeThunk = absl::Status (*)(const void* fn, TaggedValue* args);
+
+// A C++ function that scripts can call by name.
+struct NativeFunction {
+    std::string name;
+    int arity;
+    NativeThunk thunk;
+    // the callable, which only |thunk| knows the type of
+    std::shared_ptr<const void> fn;
+};
+
+// How values cross between scripts and C++: the tag a parameter must have,
+// if any, and the conversions each way. Parameters and results can be
+// int64_t (fixnums only), bool or TaggedValue (anything, unconverted), and
+// results can also be void, which returns nil.
+template <typename T>
+struct NativeType;
+
+template <>
+struct NativeType<int64_t> {
+    static constexpr std::optional<Type> kType = Type::Int;
+    static int64_t from(TaggedValue v) { return v.as.i; }
+    static TaggedValue to(int64_t i) { return TaggedValue::integer(i); }
+};
+
+template <>
+struct NativeType<bool> {
+    static constexpr std::optional<Type> kType = Type::Bool;
+    static bool from(TaggedValue v) { return v.as.b; }
+    static TaggedValue to(bool b) { return TaggedValue::boolean(b); }
+};
+
+template <>
+struct NativeType<TaggedValue> {
+    static constexpr std::optional<Type> kType = std::nullopt;
+    static TaggedValue from(TaggedValue v) { return v; }
+    static TaggedValue to(TaggedValue v) { return v; }
+};
+
+namespace native_internal {
+
+// the result and parameter types of a function pointer or a callable
+// object with a const call operator
+template <typename F>
+struct Signature : Signature<decltype(&F::operator())> {};
+template <typename R, typename... Args>
+struct Signature<R (*)(Args...)> {
+    using Result = R;
+    using Params = std::tuple<std::decay_t<Args>...>;
+};
+template <typename C, typename R, typename... Args>
+struct Signature<R (C::*)(Args...) const> : Signature<R (*)(Args...)> {};
+
+template <typename T>
+struct IsStatusOr : std::false_type {};
+template <typename T>
+struct IsStatusOr<absl::StatusOr<T>> : std::true_type {};
+
+template <typename R, typename Call>
+absl::Status store_result(Call call, TaggedValue* result) {
+    if constexpr (std::is_void_v<R>) {
+        call();
+        *result = TaggedValue::nil();
+    } else if constexpr (std::is_same_v<R, absl::Status>) {
+        if (auto status = call(); !status.ok()) return status;
+        *result = TaggedValue::nil();
+    } else if constexpr (IsStatusOr<R>::value) {
+        auto value = call();
+        if (!value.ok()) return value.status();
+        *result = NativeType<typename R::value_type>::to(*std::move(value));
+    } else {
+        *result = NativeType<R>::to(call());
+    }
+    return absl::OkStatus();
+}
+
+template <typename F, typename... Args, size_t... I>
+absl::Status unpack_and_call(const void* fn, TaggedValue* args,
+                             std::tuple<Args...>*, std::index_sequence<I...>) {
+    // check every argument before calling, so that a type error has no
+    // side effects
+    absl::Status status;
+    ([&] {
+        constexpr auto want = NativeType<Args>::kType;
+        if (!want.has_value() || args[I].typ == *want || !status.ok()) {
+            return;
+        }
+        status = absl::InvalidArgumentError(
+            absl::StrFormat("type error: want %s, got %s", to_string(*want),
+                            to_string(args[I].typ)));
+    }(), ...);
+    if (!status.ok()) return status;
+
+    const F& f = *static_cast<const F*>(fn);
+    using R = typename Signature<F>::Result;
+    return store_result<R>(
+        [&] { return f(NativeType<Args>::from(args[I])...); }, args);
+}
+
+template <typename F>
+absl::Status thunk(const void* fn, TaggedValue* args) {
+    using Params = typename Signature<F>::Params;
+    return unpack_and_call<F>(
+        fn, args, static_cast<Params*>(nullptr),
+        std::make_index_sequence<std::tuple_size_v<Params>>());
+}
+
+}  // namespace native_internal
+
+// The native functions available to scripts. Calls to them are resolved by
+// name when scripts are compiled and made by index when they run, so code
+// must run with the same Natives it was compiled with.
+//
+// The argument conversions are generated from each function's signature
+// when it is defined, so calls don't box their arguments or go through
+// std::function:
+//
+//     natives.define("square", [](int64_t x) { return x * x; });
+//
+// Functions may be called by several vms on different threads at once.
+class Natives final {
+public:
+    // Fails if |name| is already defined or names a builtin. A global
+    // variable that a script defines with the same name hides the function.
+    template <typename F>
+    absl::Status define(std::string_view name, F fn) {
+        using Params = typename native_internal::Signature<F>::Params;
+        return add(NativeFunction{
+            .name = std::string(name),
+            .arity = std::tuple_size_v<Params>,
+            .thunk = &native_internal::thunk<F>,
+            .fn = std::make_shared<const F>(std::move(fn)),
+        });
+    }
+
+    // the index of the function called |name|, if there is one
+    std::optional<int> lookup(std::string_view name) const;
+    absl::Span<const NativeFunction> functions() const { return functions_; }
+
+private:
+    absl::Status add(NativeFunction function);
+
+    std::vector<NativeFunction> functions_;
+    absl::flat_hash_map<std::string, int> index_;
+};
+
+#endif  // NATIVE_H_
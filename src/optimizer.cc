@@ -0,0 +1,101 @@
+#include "optimizer.h"
+
+#include <optional>
+#include <vector>
+
+#include "instr.h"
+
+namespace {
+// the compare-and-branch form of comparison |op|, if it has one
+std::optional<Opcode> fused_branch(Opcode op) {
+    switch (op) {
+        case Opcode::Lt: return Opcode::JmpIfNotLt;
+        case Opcode::Gt: return Opcode::JmpIfNotGt;
+        case Opcode::Eq: return Opcode::JmpIfNotEq;
+        default: return std::nullopt;
+    }
+}
+}  // namespace
+
+absl::StatusOr<Chunk> optimize(const Chunk& chunk) {
+    auto constants = load_constants(chunk.constants);
+    if (!constants.ok()) return constants.status();
+    auto decoded = decode(chunk.code);
+    if (!decoded.ok()) return decoded.status();
+    const std::vector<Instr>& code = *decoded;
+    const int n = code.size();
+
+    std::vector<bool> is_target(n + 1);
+    for (const auto& instr : code) {
+        if (has_target(instr.op)) is_target[instr.arg] = true;
+    }
+    // is the instruction at |i| an |op| that can be fused with the one
+    // before it?
+    auto fusable = [&](int i, Opcode op) {
+        return i < n && code[i].op == op && !is_target[i];
+    };
+
+    std::vector<Instr> out;
+    // index in |out| of the first instruction emitted for each instruction
+    std::vector<int> new_index(n + 1);
+    int i = 0;
+    while (i < n) {
+        new_index[i] = out.size();
+        const Instr& instr = code[i];
+
+        if (instr.op == Opcode::Swap && fusable(i + 1, Opcode::Pop)) {
+            int count = 1;
+            i += 2;
+            while (fusable(i, Opcode::Swap) && fusable(i + 1, Opcode::Pop)) {
+                new_index[i] = new_index[i + 1] = out.size();
+                count++;
+                i += 2;
+            }
+            bool merge = !out.empty() && out.back().op == Opcode::Slide &&
+                         !is_target[i - 2 * count];
+            if (merge) out.back().arg += count;
+            else out.push_back(Instr{.op = Opcode::Slide, .arg = count});
+            continue;
+        }
+
+        if (instr.op == Opcode::Get && fusable(i + 1, Opcode::Get)) {
+            new_index[i + 1] = out.size();
+            out.push_back(Instr{
+                .op = Opcode::Get2, .arg = instr.arg, .arg2 = code[i + 1].arg});
+            i += 2;
+            continue;
+        }
+
+        if (auto branch = fused_branch(instr.op);
+            branch.has_value() && fusable(i + 1, Opcode::JmpIfNot)) {
+            new_index[i + 1] = out.size();
+            out.push_back(Instr{.op = *branch, .arg = code[i + 1].arg});
+            i += 2;
+            continue;
+        }
+
+        if (instr.op == Opcode::Push && fusable(i + 1, Opcode::JmpIfNot) &&
+            instr.arg >= 0 && instr.arg < constants->size() &&
+            (*constants)[instr.arg].typ == Type::Bool) {
+            new_index[i + 1] = out.size();
+            if (!(*constants)[instr.arg].as.b) {
+                out.push_back(Instr{.op = Opcode::Jmp, .arg = code[i + 1].arg});
+            }
+            i += 2;
+            continue;
+        }
+
+        out.push_back(instr);
+        i++;
+    }
+    new_index[n] = out.size();
+
+    for (auto& instr : out) {
+        if (has_target(instr.op)) instr.arg = new_index[instr.arg];
+    }
+    return Chunk{
+        .constants = chunk.constants,
+        .code = encode(out),
+        .globals = chunk.globals,
+    };
+}
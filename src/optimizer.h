@@ -0,0 +1,21 @@
+#ifndef OPTIMIZER_H_
+#define OPTIMIZER_H_
+
+#include "absl/status/statusor.h"
+#include "chunk.h"
+
+// Peephole optimizer for compiled chunks. Rewrites instruction sequences
+// into shorter equivalent ones:
+//
+//     Swap Pop ... Swap Pop  ->  Slide N
+//     Slide N, Slide M       ->  Slide N+M
+//     Get N, Get M           ->  Get2 N M
+//     Lt, JmpIfNot Pc        ->  JmpIfNotLt Pc (and likewise for Gt, Eq)
+//     Push #t, JmpIfNot Pc   ->  (nothing)
+//     Push #f, JmpIfNot Pc   ->  Jmp Pc
+//
+// Sequences are only fused when no jump or function entry lands inside
+// them.
+absl::StatusOr<Chunk> optimize(const Chunk& chunk);
+
+#endif  // OPTIMIZER_H_
@@ -0,0 +1,56 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <deque>
+#include <optional>
+#include <thread>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace {
+struct Worker {
+    absl::Mutex mu;
+    // indices of the tasks this worker hasn't started, or had stolen
+    std::deque<int> tasks ABSL_GUARDED_BY(mu);
+};
+}  // namespace
+
+void run_parallel(int num_threads, std::vector<std::function<void()>> tasks) {
+    if (tasks.empty()) return;
+    const int n = std::clamp<int>(num_threads, 1, tasks.size());
+    std::vector<Worker> workers(n);
+    for (int i = 0; i < tasks.size(); i++) {
+        Worker& worker = workers[i % n];
+        absl::MutexLock lock(&worker.mu);
+        worker.tasks.push_back(i);
+    }
+
+    // no tasks are added once the threads start, so a thread that finds
+    // every deque empty is done
+    auto next = [&workers, n](int self) -> std::optional<int> {
+        for (int i = 0; i < n; i++) {
+            Worker& worker = workers[(self + i) % n];
+            absl::MutexLock lock(&worker.mu);
+            if (worker.tasks.empty()) continue;
+            int task;
+            if (i == 0) {
+                task = worker.tasks.back();
+                worker.tasks.pop_back();
+            } else {
+                task = worker.tasks.front();
+                worker.tasks.pop_front();
+            }
+            return task;
+        }
+        return std::nullopt;
+    };
+    auto work = [&tasks, &next](int self) {
+        while (auto task = next(self)) tasks[*task]();
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < n; i++) threads.emplace_back(work, i);
+    work(0);
+    for (auto& thread : threads) thread.join();
+}
@@ -0,0 +1,16 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <functional>
+#include <vector>
+
+// Runs independent |tasks| on |num_threads| threads, including the calling
+// one, and returns once all of them have finished.
+//
+// Each thread has its own deque of tasks, dealt round-robin up front. A
+// thread takes tasks from the back of its own deque and, once that is
+// empty, steals from the front of the others', so threads that drew short
+// tasks take over the work of threads that drew long ones.
+void run_parallel(int num_threads, std::vector<std::function<void()>> tasks);
+
+#endif  // PARALLEL_H_
@@ -1,7 +1,7 @@
 #include "parser.h"
 
-#include <stdexcept>
-
+#include "absl/container/inlined_vector.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_format.h"
 
 namespace {
@@ -14,6 +14,10 @@ absl::Status err(int line, std::string_view message) {
     return absl::InvalidArgumentError(s);
 }
 
+Symbol to_symbol(const Token& tok) {
+    return Symbol{.id = tok.symbol, .name = tok.cargo};
+}
+
 absl::Status invalid(TokenType want, const Token& tok) {
     auto s = absl::StrFormat("want %s, got %s", to_string(want), tok.cargo);
     return err(tok.line, s);
@@ -22,25 +26,40 @@ absl::Status invalid(TokenType want, const Token& tok) {
 
 class Parser final {
 public:
-    // |toks| must outlive the constructed Parser
-    explicit Parser(const std::vector<Token>& toks) : toks_(toks) {}
+    // |toks| and |arena| must outlive the constructed Parser
+    Parser(const std::vector<Token>& toks, Arena* arena)
+        : toks_(toks), arena_(arena) {}
     bool at_end() const { return pos_ >= toks_.size(); }
 
     absl::StatusOr<Stmt> stmt();
+    absl::StatusOr<DefineStmt> define_stmt();
     absl::StatusOr<Expr> expr();
     absl::StatusOr<BoolExpr> bool_lit();
-    absl::StatusOr<IntExpr> int_lit();
+    absl::StatusOr<Expr> int_lit();
+    absl::StatusOr<NilExpr> nil_lit();
     absl::StatusOr<IfExpr> if_expr();
     absl::StatusOr<LetExpr> let_expr();
     absl::StatusOr<SymbolExpr> symbol_expr();
+    absl::StatusOr<BuiltinExpr> builtin_expr();
+    absl::StatusOr<LambdaExpr> lambda_expr();
+    absl::StatusOr<CallExpr> call_expr();
 
 private:
+    // parses expressions up to the next Rparen, which isn't consumed
+    absl::StatusOr<absl::Span<const Expr* const>> exprs();
+    // parses symbols up to and including the next Rparen
+    absl::StatusOr<absl::Span<const Symbol>> params();
+
     std::optional<const Token*> peek(int n = 0) const;
     bool peek_is(TokenType typ, int n = 0) const;
-    std::optional<Token> advance();
-    absl::StatusOr<Token> match(TokenType typ);
+    std::optional<const Token*> advance();
+    absl::StatusOr<const Token*> match(TokenType typ);
+
+    // allocates |expr| in the arena
+    const Expr* make(Expr expr) { return arena_->make<Expr>(std::move(expr)); }
 
     const std::vector<Token>& toks_;
+    Arena* arena_;
     int pos_ = 0;
 };
 
@@ -54,11 +73,11 @@ bool Parser::peek_is(TokenType typ, int n) const {
     return tok.has_value() && (*tok)->typ == typ;
 }
 
-std::optional<Token> Parser::advance() {
-    return at_end() ? std::nullopt : std::optional{toks_[pos_++]};
+std::optional<const Token*> Parser::advance() {
+    return at_end() ? std::nullopt : std::optional{&toks_[pos_++]};
 }
 
-absl::StatusOr<Token> Parser::match(TokenType want) {
+absl::StatusOr<const Token*> Parser::match(TokenType want) {
     auto tok = peek();
     if (!tok) return unexpected_eof();
     if ((*tok)->typ != want) return invalid(want, **tok);
@@ -69,31 +88,73 @@ absl::StatusOr<BoolExpr> Parser::bool_lit() {
     auto tok = match(TokenType::Bool);
     if (!tok.ok()) return tok.status();
     auto bool_value = [&tok]() -> absl::StatusOr<bool> {
-        if (tok->cargo == "#t") return true;
-        if (tok->cargo == "#f") return false;
-        return invalid(TokenType::Bool, *tok);
+        if ((*tok)->cargo == "#t") return true;
+        if ((*tok)->cargo == "#f") return false;
+        return invalid(TokenType::Bool, **tok);
     }();
     if (!bool_value.ok()) return bool_value.status();
-    return BoolExpr{.line = tok->line, .value = *bool_value};
+    return BoolExpr{.line = (*tok)->line, .value = *bool_value};
 }
 
-absl::StatusOr<IntExpr> Parser::int_lit() {
+absl::StatusOr<Expr> Parser::int_lit() {
     auto tok = match(TokenType::Int);
     if (!tok.ok()) return tok.status();
-    int int_value;
-    try {
-        int_value = std::stoi(tok.value().cargo);
-    } catch (std::out_of_range& e) {
-        return err(tok->line,
-                   absl::StrFormat("int out of range: %s", tok->cargo));
+    const int line = (*tok)->line;
+    std::string_view text = (*tok)->cargo;
+    int64_t int_value;
+    if (absl::SimpleAtoi(text, &int_value)) {
+        return IntExpr{.line = line, .value = int_value};
+    }
+
+    // There are no bignum constants, so a literal too large for a fixnum is
+    // built from fixnum pieces of up to 18 digits each, which the vm
+    // promotes to a bignum: 12...34 becomes (+ (* 12... 10^18) ...34).
+    constexpr int kPieceDigits = 18;
+    constexpr int64_t kPieceBase = 1000000000000000000;
+    const bool negative = text.front() == '-';
+    if (negative) text.remove_prefix(1);
+    const int sign = negative ? -1 : 1;
+    auto piece = [&](std::string_view digits) -> absl::StatusOr<Expr> {
+        int64_t value;
+        if (!absl::SimpleAtoi(digits, &value)) {
+            return err(line, absl::StrFormat("bad int: %s", (*tok)->cargo));
+        }
+        return IntExpr{.line = line, .value = sign * value};
+    };
+    auto builtin = [&](Builtin op, Expr a, Expr b) {
+        const Expr* args[] = {make(std::move(a)), make(std::move(b))};
+        return BuiltinExpr{
+            .line = line,
+            .op = op,
+            .args = arena_->copy(absl::MakeConstSpan(args)),
+        };
+    };
+    int first = text.size() % kPieceDigits;
+    if (first == 0) first = kPieceDigits;
+    auto value = piece(text.substr(0, first));
+    if (!value.ok()) return value.status();
+    Expr expr = *std::move(value);
+    for (int at = first; at < text.size(); at += kPieceDigits) {
+        auto next = piece(text.substr(at, kPieceDigits));
+        if (!next.ok()) return next.status();
+        Expr scaled =
+            builtin(Builtin::Mul, std::move(expr),
+                    IntExpr{.line = line, .value = kPieceBase});
+        expr = builtin(Builtin::Add, std::move(scaled), *std::move(next));
     }
-    return IntExpr{.line = tok->line, .value = int_value};
+    return expr;
+}
+
+absl::StatusOr<NilExpr> Parser::nil_lit() {
+    auto tok = match(TokenType::Nil);
+    if (!tok.ok()) return tok.status();
+    return NilExpr{.line = (*tok)->line};
 }
 
 absl::StatusOr<SymbolExpr> Parser::symbol_expr() {
     auto tok = match(TokenType::Symbol);
     if (!tok.ok()) return tok.status();
-    return SymbolExpr{.line = tok->line, .name = tok->cargo};
+    return SymbolExpr{.line = (*tok)->line, .symbol = to_symbol(**tok)};
 }
 
 absl::StatusOr<IfExpr> Parser::if_expr() {
@@ -109,10 +170,10 @@ absl::StatusOr<IfExpr> Parser::if_expr() {
     if (!alt.ok()) return alt.status();
     if (auto tok = match(TokenType::Rparen); !tok.ok()) return tok.status();
     return IfExpr{
-        .line = tok->line,
-        .cond = std::make_unique<Expr>(*std::move(cond)),
-        .conseq = std::make_unique<Expr>(*std::move(cons)),
-        .alt = std::make_unique<Expr>(*std::move(alt)),
+        .line = (*tok)->line,
+        .cond = make(*std::move(cond)),
+        .conseq = make(*std::move(cons)),
+        .alt = make(*std::move(alt)),
     };
 }
 
@@ -122,7 +183,7 @@ absl::StatusOr<LetExpr> Parser::let_expr() {
     if (auto tok = match(TokenType::Let); !tok.ok()) return tok.status();
 
     // bindings
-    std::vector<std::pair<std::string, Expr>> bindings;
+    absl::InlinedVector<Binding, 8> bindings;
     if (auto tok = match(TokenType::Lparen); !tok.ok()) return tok.status();
     while (!peek_is(TokenType::Rparen)) {
         if (auto tok = match(TokenType::Lparen); !tok.ok()) return tok.status();
@@ -130,7 +191,8 @@ absl::StatusOr<LetExpr> Parser::let_expr() {
         if (!name.ok()) return name.status();
         auto binding = expr();
         if (!binding.ok()) return binding.status();
-        bindings.emplace_back(name->cargo, *std::move(binding));
+        bindings.push_back(Binding{.name = to_symbol(**name),
+                                   .value = make(*std::move(binding))});
         if (auto tok = match(TokenType::Rparen); !tok.ok()) return tok.status();
     }
     if (auto tok = match(TokenType::Rparen); !tok.ok()) return tok.status();
@@ -141,31 +203,163 @@ absl::StatusOr<LetExpr> Parser::let_expr() {
 
     if (auto tok = match(TokenType::Rparen); !tok.ok()) return tok.status();
     return LetExpr{
-        .line = tok->line,
-        .bindings = std::move(bindings),
-        .body = std::make_unique<Expr>(*std::move(subexpr)),
+        .line = (*tok)->line,
+        .bindings = arena_->copy(absl::MakeConstSpan(bindings)),
+        .body = make(*std::move(subexpr)),
     };
 }
 
+absl::StatusOr<BuiltinExpr> Parser::builtin_expr() {
+    auto tok = match(TokenType::Lparen);
+    if (!tok.ok()) return tok.status();
+    auto name = match(TokenType::Symbol);
+    if (!name.ok()) return name.status();
+    auto op = lookup_builtin((*name)->cargo);
+    if (!op.has_value()) return err((*name)->line, "invalid expr");
+
+    auto args = exprs();
+    if (!args.ok()) return args.status();
+    if (auto tok = match(TokenType::Rparen); !tok.ok()) return tok.status();
+
+    if (args->size() != arity(*op)) {
+        return err((*tok)->line,
+                   absl::StrFormat("%s takes %d arguments, got %d",
+                                   to_string(*op), arity(*op), args->size()));
+    }
+    return BuiltinExpr{.line = (*tok)->line, .op = *op, .args = *args};
+}
+
+absl::StatusOr<LambdaExpr> Parser::lambda_expr() {
+    auto tok = match(TokenType::Lparen);
+    if (!tok.ok()) return tok.status();
+    if (auto tok = match(TokenType::Lambda); !tok.ok()) return tok.status();
+    if (auto tok = match(TokenType::Lparen); !tok.ok()) return tok.status();
+    auto names = params();
+    if (!names.ok()) return names.status();
+    auto body = expr();
+    if (!body.ok()) return body.status();
+    if (auto tok = match(TokenType::Rparen); !tok.ok()) return tok.status();
+    return LambdaExpr{
+        .line = (*tok)->line,
+        .params = *names,
+        .body = make(*std::move(body)),
+    };
+}
+
+absl::StatusOr<CallExpr> Parser::call_expr() {
+    auto tok = match(TokenType::Lparen);
+    if (!tok.ok()) return tok.status();
+    auto fn = expr();
+    if (!fn.ok()) return fn.status();
+    auto args = exprs();
+    if (!args.ok()) return args.status();
+    if (auto tok = match(TokenType::Rparen); !tok.ok()) return tok.status();
+    return CallExpr{
+        .line = (*tok)->line,
+        .fn = make(*std::move(fn)),
+        .args = *args,
+    };
+}
+
+absl::StatusOr<absl::Span<const Expr* const>> Parser::exprs() {
+    absl::InlinedVector<const Expr*, 4> items;
+    while (!peek_is(TokenType::Rparen)) {
+        auto item = expr();
+        if (!item.ok()) return item.status();
+        items.push_back(make(*std::move(item)));
+    }
+    return arena_->copy(absl::MakeConstSpan(items));
+}
+
+absl::StatusOr<absl::Span<const Symbol>> Parser::params() {
+    absl::InlinedVector<Symbol, 4> names;
+    while (!peek_is(TokenType::Rparen)) {
+        auto name = match(TokenType::Symbol);
+        if (!name.ok()) return name.status();
+        names.push_back(to_symbol(**name));
+    }
+    if (auto tok = match(TokenType::Rparen); !tok.ok()) return tok.status();
+    return arena_->copy(absl::MakeConstSpan(names));
+}
+
 absl::StatusOr<Expr> Parser::expr() {
     auto tok = peek();
     if (!tok.has_value()) return unexpected_eof();
     switch ((*tok)->typ) {
         case TokenType::Bool: return bool_lit();
         case TokenType::Int: return int_lit();
+        case TokenType::Nil: return nil_lit();
         case TokenType::Symbol: return symbol_expr();
         case TokenType::Lparen: {
             if (peek_is(TokenType::If, 1)) return if_expr();
             if (peek_is(TokenType::Let, 1)) return let_expr();
+            if (peek_is(TokenType::Lambda, 1)) return lambda_expr();
+            if (peek_is(TokenType::Symbol, 1) &&
+                lookup_builtin((*peek(1))->cargo).has_value()) {
+                return builtin_expr();
+            }
+            return call_expr();
         }
         default: return err((*tok)->line, "invalid expr");
     }
 }
 
-absl::StatusOr<Stmt> Parser::stmt() { return expr(); }
+absl::StatusOr<DefineStmt> Parser::define_stmt() {
+    auto tok = match(TokenType::Lparen);
+    if (!tok.ok()) return tok.status();
+    const bool memo = peek_is(TokenType::DefineMemo);
+    if (auto tok = match(memo ? TokenType::DefineMemo : TokenType::Define);
+        !tok.ok()) {
+        return tok.status();
+    }
+
+    // (define (f x y) body) is short for (define f (lambda (x y) body))
+    if (peek_is(TokenType::Lparen)) {
+        if (auto tok = match(TokenType::Lparen); !tok.ok()) return tok.status();
+        auto name = match(TokenType::Symbol);
+        if (!name.ok()) return name.status();
+        auto names = params();
+        if (!names.ok()) return names.status();
+        auto body = expr();
+        if (!body.ok()) return body.status();
+        if (auto tok = match(TokenType::Rparen); !tok.ok()) return tok.status();
+        return DefineStmt{
+            .line = (*tok)->line,
+            .name = to_symbol(**name),
+            .value = make(LambdaExpr{
+                .line = (*tok)->line,
+                .params = *names,
+                .body = make(*std::move(body)),
+            }),
+            .memo = memo,
+        };
+    }
+    // only functions can be memoized
+    if (memo) return err((*tok)->line, "define-memo needs a function");
+
+    auto name = match(TokenType::Symbol);
+    if (!name.ok()) return name.status();
+    auto value = expr();
+    if (!value.ok()) return value.status();
+    if (auto tok = match(TokenType::Rparen); !tok.ok()) return tok.status();
+    return DefineStmt{
+        .line = (*tok)->line,
+        .name = to_symbol(**name),
+        .value = make(*std::move(value)),
+    };
+}
+
+absl::StatusOr<Stmt> Parser::stmt() {
+    if (peek_is(TokenType::Lparen) && (peek_is(TokenType::Define, 1) ||
+                                       peek_is(TokenType::DefineMemo, 1))) {
+        return define_stmt();
+    }
+    return expr();
+}
 
-absl::StatusOr<std::vector<Stmt>> parse(const std::vector<Token>& toks) {
-    Parser parse(toks);
+absl::StatusOr<std::vector<Stmt>> parse(const std::vector<Token>& toks,
+                                         Arena* arena) {
+    Parser parse(toks, arena);
     std::vector<Stmt> stmts;
     while (!parse.at_end()) {
         auto st = parse.stmt();
@@ -6,9 +6,13 @@
 #include <vector>
 
 #include "absl/status/statusor.h"
+#include "arena.h"
 #include "ast.h"
 #include "token.h"
 
-absl::StatusOr<std::vector<Stmt>> parse(const std::vector<Token>& toks);
+// parses |toks| into statements whose nodes are allocated in |arena|, so
+// they are only valid as long as it is
+absl::StatusOr<std::vector<Stmt>> parse(const std::vector<Token>& toks,
+                                         Arena* arena);
 
 #endif  // PARSER_H_
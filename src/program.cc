@@ -0,0 +1,66 @@
+#include "program.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/strings/str_format.h"
+
+absl::StatusOr<int> validate(absl::Span<const Instr> code, int num_constants,
+                             const Natives* natives, int num_globals) {
+    for (const auto& instr : code) {
+        if (instr.op == Opcode::Push &&
+            (instr.arg < 0 || instr.arg >= num_constants)) {
+            return absl::InvalidArgumentError(
+                absl::StrFormat("bad constant index: %d", instr.arg));
+        }
+        if (instr.op == Opcode::GetGlobal || instr.op == Opcode::SetGlobal) {
+            if (instr.arg < 0) {
+                return absl::InvalidArgumentError(
+                    absl::StrFormat("bad global slot: %d", instr.arg));
+            }
+            num_globals = std::max(num_globals, instr.arg + 1);
+        }
+        if (instr.op == Opcode::MakeClosure &&
+            (instr.arg2 < 0 || instr.arg3 < 0)) {
+            return absl::InvalidArgumentError("bad closure");
+        }
+        if ((instr.op == Opcode::MemoGet && instr.arg2 < 0) ||
+            (instr.op == Opcode::MemoPut && instr.arg < 0)) {
+            return absl::InvalidArgumentError("bad memo table");
+        }
+        if (instr.op == Opcode::CallNative) {
+            auto functions = natives != nullptr
+                                 ? natives->functions()
+                                 : absl::Span<const NativeFunction>();
+            if (instr.arg < 0 || instr.arg >= functions.size() ||
+                instr.arg2 != functions[instr.arg].arity) {
+                return absl::InvalidArgumentError(absl::StrFormat(
+                    "bad native function call: %d", instr.arg));
+            }
+        }
+    }
+    return num_globals;
+}
+
+absl::StatusOr<std::shared_ptr<const Program>> Program::load(
+    ChunkView chunk, std::shared_ptr<const Natives> natives) {
+    auto constants = load_constants(chunk.constants);
+    if (!constants.ok()) return constants.status();
+    auto code = decode(chunk.code);
+    if (!code.ok()) return code.status();
+    auto num_globals = validate(*code, constants->size(), natives.get());
+    if (!num_globals.ok()) return num_globals.status();
+    auto globals = load_global_names(chunk.globals, *num_globals);
+    if (!globals.ok()) return globals.status();
+
+    std::shared_ptr<Program> program(new Program);
+    program->code_ = *std::move(code);
+    program->code_.push_back(Instr{.op = Opcode::Halt});
+    program->constants_ = *std::move(constants);
+    program->num_globals_ = *num_globals;
+    program->global_names_ = std::move(globals->names);
+    program->global_names_.insert(program->global_names_.begin(),
+                                  globals->first, "");
+    program->natives_ = std::move(natives);
+    return program;
+}
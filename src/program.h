@@ -0,0 +1,55 @@
+#ifndef PROGRAM_H_
+#define PROGRAM_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "chunk.h"
+#include "instr.h"
+#include "native.h"
+#include "value.h"
+
+// Checks the operands of decoded |code| that decode() can't: constant
+// indices against the |num_constants| in the pool, global slots, closures,
+// memo tables and calls to |natives|, which may be null. Returns the number
+// of global slots the code needs, which is at least |num_globals|.
+absl::StatusOr<int> validate(absl::Span<const Instr> code, int num_constants,
+                             const Natives* natives, int num_globals = 0);
+
+// A chunk that has been loaded, decoded and validated once and can then be
+// run any number of times. A Program is immutable once loaded, so a single
+// one can be shared, through a shared_ptr, by VMs running on many threads
+// at once: the code and constants are never copied, and each VM keeps its
+// own stack, heap and globals.
+class Program final {
+public:
+    // |natives| are the native functions the chunk was compiled with
+    static absl::StatusOr<std::shared_ptr<const Program>> load(
+        ChunkView chunk, std::shared_ptr<const Natives> natives = nullptr);
+
+    // the decoded code, which ends with Halt
+    absl::Span<const Instr> code() const { return code_; }
+    absl::Span<const TaggedValue> constants() const { return constants_; }
+    int num_globals() const { return num_globals_; }
+    // name of each global slot that the chunk named, for errors
+    absl::Span<const std::string> global_names() const {
+        return global_names_;
+    }
+    // null if the program calls no native functions
+    const Natives* natives() const { return natives_.get(); }
+
+private:
+    Program() = default;
+
+    std::vector<Instr> code_;
+    std::vector<TaggedValue> constants_;
+    int num_globals_ = 0;
+    std::vector<std::string> global_names_;
+    std::shared_ptr<const Natives> natives_;
+};
+
+#endif  // PROGRAM_H_
@@ -13,6 +13,7 @@ bool is_symbol(char ch) {
         case '=':
         case '<':
         case '>':
+        case '?':
         case '-': return true;
         default: return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z');
     }
@@ -26,8 +27,9 @@ bool is_terminating(std::optional<char> ch) {
 
 class Scanner final {
 public:
-    // |text| must outlive the constructed Scanner
-    Scanner(std::string_view text) : text_(text) {}
+    // |text| and |symbols| must outlive the constructed Scanner
+    Scanner(std::string_view text, SymbolTable* symbols)
+        : text_(text), symbols_(symbols) {}
     absl::StatusOr<std::optional<Token>> next();
     bool at_end() const { return pos_ >= text_.size(); }
 
@@ -46,6 +48,7 @@ private:
     int pos_ = 0;
     int line_ = 1;
     std::string_view text_;
+    SymbolTable* symbols_;
 };
 
 std::optional<char> Scanner::advance() {
@@ -66,13 +69,16 @@ std::string_view Scanner::peek_cargo() const {
 }
 
 Token Scanner::token(TokenType typ) const {
-    std::string cargo(peek_cargo());
-    return Token{.line = line_, .cargo = cargo, .typ = typ};
+    return Token{.typ = typ, .line = line_, .cargo = peek_cargo()};
 }
 
 TokenType lookup_keyword(std::string_view s) {
     if (s == "if") return TokenType::If;
     if (s == "let") return TokenType::Let;
+    if (s == "define") return TokenType::Define;
+    if (s == "define-memo") return TokenType::DefineMemo;
+    if (s == "nil") return TokenType::Nil;
+    if (s == "lambda") return TokenType::Lambda;
     return TokenType::Symbol;
 }
 
@@ -85,7 +91,14 @@ absl::StatusOr<Token> Scanner::symbol() {
         }
         advance();
     }
-    return token(lookup_keyword(peek_cargo()));
+    auto tok = token(lookup_keyword(peek_cargo()));
+    if (tok.typ == TokenType::Symbol) {
+        // point at the interned copy so each distinct name is stored once
+        auto symbol = symbols_->intern(tok.cargo);
+        tok.symbol = symbol.id;
+        tok.cargo = symbol.name;
+    }
+    return tok;
 }
 
 absl::StatusOr<Token> Scanner::number() {
@@ -137,14 +150,36 @@ absl::StatusOr<std::optional<Token>> Scanner::next() {
     return std::nullopt;
 }
 
-absl::StatusOr<std::vector<Token>> scan(std::string_view text) {
-    Scanner scan(text);
+absl::StatusOr<std::vector<Token>> scan(std::string_view text,
+                                        SymbolTable* symbols) {
+    Scanner scan(text, symbols);
     std::vector<Token> toks;
+    // typical tokens plus their separating whitespace take a few bytes each
+    toks.reserve(text.size() / 4);
     while (!scan.at_end()) {
         auto tok = scan.next();
         if (!tok.ok()) return tok.status();
         if (!tok->has_value()) break;
-        toks.push_back(**tok);
+        toks.push_back(std::move(**tok));
     }
     return toks;
 }
+
+StmtScanner::StmtScanner(std::string_view text, SymbolTable* symbols)
+    : scanner_(std::make_unique<Scanner>(text, symbols)) {}
+
+StmtScanner::~StmtScanner() = default;
+
+absl::StatusOr<std::vector<Token>> StmtScanner::next() {
+    std::vector<Token> toks;
+    int depth = 0;
+    do {
+        auto tok = scanner_->next();
+        if (!tok.ok()) return tok.status();
+        if (!tok->has_value()) break;
+        if ((*tok)->typ == TokenType::Lparen) depth++;
+        else if ((*tok)->typ == TokenType::Rparen) depth--;
+        toks.push_back(std::move(**tok));
+    } while (depth > 0);
+    return toks;
+}
@@ -1,13 +1,38 @@
 #ifndef SCANNER_H_
 #define SCANNER_H_
 
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
 #include "absl/status/statusor.h"
+#include "symbols.h"
 #include "token.h"
 
-absl::StatusOr<std::vector<Token>> scan(std::string_view text);
+// the returned tokens point into |text|, which must outlive them. symbol
+// names are interned in |symbols|.
+absl::StatusOr<std::vector<Token>> scan(std::string_view text,
+                                        SymbolTable* symbols);
+
+class Scanner;
+
+// Scans |text| one top-level statement at a time, so that each statement
+// can be parsed and run before the rest of |text| has been scanned. The
+// tokens point into |text| as they do for scan().
+class StmtScanner final {
+public:
+    // |text| and |symbols| must outlive the constructed StmtScanner
+    StmtScanner(std::string_view text, SymbolTable* symbols);
+    ~StmtScanner();
+
+    // the tokens of the next statement, which are a lone atom or run from
+    // an Lparen to the Rparen that closes it or to the end of |text|, and
+    // are empty at the end of |text|
+    absl::StatusOr<std::vector<Token>> next();
+
+private:
+    std::unique_ptr<Scanner> scanner_;
+};
 
 #endif  // SCANNER_H_
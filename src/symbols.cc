@@ -0,0 +1,12 @@
+#include "symbols.h"
+
+Symbol SymbolTable::intern(std::string_view name) {
+    if (auto it = ids_.find(name); it != ids_.end()) {
+        return Symbol{.id = it->second, .name = names_[it->second]};
+    }
+    std::string_view owned = arena_.copy(name);
+    int id = names_.size();
+    names_.push_back(owned);
+    ids_.emplace(owned, id);
+    return Symbol{.id = id, .name = owned};
+}
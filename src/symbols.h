@@ -0,0 +1,32 @@
+#ifndef SYMBOLS_H_
+#define SYMBOLS_H_
+
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "arena.h"
+
+// An interned symbol. Equal names have equal ids, so symbols can be
+// compared as integers; the name is owned by the SymbolTable.
+struct Symbol {
+    int id;
+    std::string_view name;
+};
+
+// Maps symbol names to dense integer ids, storing each distinct name once.
+// Ids and names stay valid for the lifetime of the table.
+class SymbolTable final {
+public:
+    Symbol intern(std::string_view name);
+    std::string_view name(int id) const { return names_[id]; }
+    int size() const { return names_.size(); }
+
+private:
+    Arena arena_;
+    // keys point into |arena_|
+    absl::flat_hash_map<std::string_view, int> ids_;
+    std::vector<std::string_view> names_;
+};
+
+#endif  // SYMBOLS_H_
@@ -11,6 +11,10 @@ std::string to_string(TokenType typ) {
         case TokenType::Int: return "Int";
         case TokenType::If: return "If";
         case TokenType::Let: return "Let";
+        case TokenType::Define: return "Define";
+        case TokenType::DefineMemo: return "DefineMemo";
+        case TokenType::Nil: return "Nil";
+        case TokenType::Lambda: return "Lambda";
     }
 }
 
@@ -2,6 +2,9 @@
 #define TOKEN_H_
 
 #include <string>
+#include <string_view>
+
+#include "symbols.h"
 
 enum class TokenType {
     Bool,
@@ -11,14 +14,22 @@ enum class TokenType {
     Symbol,
     If,
     Let,
+    Define,
+    DefineMemo,
+    Nil,
+    Lambda,
 };
 
 std::string to_string(TokenType typ);
 
+// A token refers to its lexeme in the scanned text rather than owning a
+// copy, so tokens must not outlive the text they were scanned from.
 struct Token final {
     TokenType typ;
     int line;
-    std::string cargo;
+    std::string_view cargo;
+    // interned id of Symbol tokens, whose cargo is the interned name
+    int symbol = -1;
 
     std::string str() const;
 };
@@ -1,49 +1,110 @@
 #include "value.h"
 
 #include "absl/strings/str_format.h"
+#include "bignum.h"
+
+void serialize_int32(int32_t x, std::vector<char>* buf) {
+    auto end = buf->size();
+    buf->resize(end + 4);
+    serialize_int32(x, buf, end);
+}
+
+void serialize_int32(int32_t x, std::vector<char>* buf, int at) {
+    uint32_t u = x;
+    for (int i = 0; i < 4; i++) {
+        (*buf)[at + i] = static_cast<char>(u >> (8 * i));
+    }
+}
+
+absl::StatusOr<int32_t> deserialize_int32(absl::Span<const char> buf,
+                                          int at) {
+    if (at < 0 || at + 4 > buf.size()) {
+        return absl::InvalidArgumentError("can't parse int: not enough bytes");
+    }
+    uint32_t u = 0;
+    for (int i = 0; i < 4; i++) {
+        u |= static_cast<uint32_t>(static_cast<unsigned char>(buf[at + i]))
+             << (8 * i);
+    }
+    return static_cast<int32_t>(u);
+}
 
 void BoolValue::serialize_value(std::vector<char>* buf) const {
     buf->push_back(static_cast<char>(value_));
 }
 
 void IntValue::serialize_value(std::vector<char>* buf) const {
-    auto end = buf->size();
-    buf->resize(end + 4);
-    serialize_value(buf, end);
-}
-
-void IntValue::serialize_value(std::vector<char>* buf, int at) const {
-    unsigned int x = value_;
-    (*buf)[at] = static_cast<char>(x & 0xFF);
-    (*buf)[at + 1] = static_cast<char>((x >> 8) & 0xFF);
-    (*buf)[at + 2] = static_cast<char>((x >> 16) & 0xFF);
-    (*buf)[at + 3] = static_cast<char>((x >> 24) & 0xFF);
+    uint64_t x = value_;
+    for (int i = 0; i < 8; i++) {
+        buf->push_back(static_cast<char>(x >> (8 * i)));
+    }
 }
 
 absl::StatusOr<std::unique_ptr<BoolValue>> BoolValue::deserialize(
-    const std::vector<char>& buf, int at) {
+    absl::Span<const char> buf, int at) {
+    if (at >= buf.size()) {
+        return absl::InvalidArgumentError("can't parse bool: not enough bytes");
+    }
     return std::make_unique<BoolValue>(static_cast<bool>(buf[at]));
 }
 
 absl::StatusOr<std::unique_ptr<IntValue>> IntValue::deserialize(
-    const std::vector<char>& buf, int at) {
-    if (at + 4 > buf.size()) {
+    absl::Span<const char> buf, int at) {
+    if (at + 8 > buf.size()) {
         return absl::InvalidArgumentError("can't parse int: not enough bytes");
     }
-    unsigned int x0 = static_cast<unsigned char>(buf[at++]);
-    unsigned int x1 = static_cast<unsigned char>(buf[at++]);
-    unsigned int x2 = static_cast<unsigned char>(buf[at++]);
-    unsigned int x3 = static_cast<unsigned char>(buf[at++]);
-    int int_value = static_cast<int>(x0 + (x1 << 8) + (x2 << 16) + (x3 << 24));
-    return std::make_unique<IntValue>(static_cast<int>(int_value));
+    uint64_t x = 0;
+    for (int i = 0; i < 8; i++) {
+        x |= static_cast<uint64_t>(static_cast<unsigned char>(buf[at + i]))
+             << (8 * i);
+    }
+    return std::make_unique<IntValue>(static_cast<int64_t>(x));
 }
 
 absl::StatusOr<std::unique_ptr<Value>> Value::deserialize(
-    const std::vector<char>& buf, int at) {
+    absl::Span<const char> buf, int at) {
+    if (at >= buf.size()) {
+        return absl::InvalidArgumentError("can't parse value: not enough bytes");
+    }
     char typ = buf[at++];
     switch (static_cast<Type>(typ)) {
         case Type::Bool: return BoolValue::deserialize(buf, at);
         case Type::Int: return IntValue::deserialize(buf, at);
+        case Type::Nil: return std::make_unique<NilValue>();
+        case Type::Pair:
+        case Type::Closure:
+        case Type::BigInt: break;
     }
     return absl::InvalidArgumentError(absl::StrFormat("bad type: %d", typ));
 }
+
+namespace {
+// prints a list as (1 2 3) and an improper one as (1 2 . 3), walking the
+// cdrs iteratively so that long lists don't exhaust the native stack
+std::string list_str(const Pair* pair) {
+    std::string s = "(" + pair->car.str();
+    TaggedValue rest = pair->cdr;
+    while (rest.typ == Type::Pair) {
+        pair = static_cast<const Pair*>(rest.as.obj);
+        s += " " + pair->car.str();
+        rest = pair->cdr;
+    }
+    if (rest.typ != Type::Nil) s += " . " + rest.str();
+    return s + ")";
+}
+}  // namespace
+
+std::string TaggedValue::str() const {
+    switch (typ) {
+        case Type::Bool: return as.b ? "true" : "false";
+        case Type::Int: return std::to_string(as.i);
+        case Type::Nil: return "nil";
+        case Type::Pair: return list_str(static_cast<const Pair*>(as.obj));
+        case Type::Closure: return "<function>";
+        case Type::BigInt: {
+            const auto* big = static_cast<const BigInt*>(as.obj);
+            auto digits = absl::MakeConstSpan(big->digits(), big->num_digits);
+            return Bignum(big->negative, digits).str();
+        }
+    }
+}
@@ -1,23 +1,169 @@
 #ifndef VALUE_H_
 #define VALUE_H_
 
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 
 enum class Type {
     Bool = 1,
     Int = 2,
+    Nil = 3,
+    Pair = 4,
+    Closure = 5,
+    BigInt = 6,
 };
 
+// the tag of a global slot whose define hasn't run yet, which no value has
+constexpr Type kUndefined = static_cast<Type>(0);
+
 constexpr const char* to_string(Type typ) {
     switch (typ) {
         case Type::Bool: return "Bool";
         case Type::Int: return "Int";
+        case Type::Nil: return "Nil";
+        case Type::Pair: return "Pair";
+        case Type::Closure: return "Closure";
+        case Type::BigInt: return "BigInt";
     }
 }
 
+// are values of type |typ| allocated on the heap?
+constexpr bool is_object(Type typ) {
+    return typ == Type::Pair || typ == Type::Closure || typ == Type::BigInt;
+}
+
+// is |typ| a fixnum or a bignum?
+constexpr bool is_integer(Type typ) {
+    return typ == Type::Int || typ == Type::BigInt;
+}
+
+struct Object;
+struct Pair;
+struct Closure;
+struct BigInt;
+
+// Unboxed runtime representation of a value: a type tag and an inline
+// payload. The vm keeps these directly on its stack, so moving values
+// around never allocates. Integers are 64-bit fixnums unless they don't
+// fit, in which case they're BigInts on the heap.
+struct TaggedValue {
+    Type typ;
+    union {
+        bool b;
+        int64_t i;
+        Object* obj;
+    } as;
+
+    static TaggedValue boolean(bool b) {
+        TaggedValue v;
+        v.typ = Type::Bool;
+        v.as.b = b;
+        return v;
+    }
+    static TaggedValue integer(int64_t i) {
+        TaggedValue v;
+        v.typ = Type::Int;
+        v.as.i = i;
+        return v;
+    }
+    static TaggedValue nil() {
+        TaggedValue v;
+        v.typ = Type::Nil;
+        return v;
+    }
+    static TaggedValue pair(Pair* pair);
+    static TaggedValue closure(Closure* closure);
+    static TaggedValue bigint(BigInt* bigint);
+
+    std::string str() const;
+};
+
+static_assert(std::is_trivially_copyable_v<TaggedValue>);
+
+// Header of every object allocated on the heap. |size| includes the header.
+struct Object {
+    Type typ;
+    uint32_t size;
+    // where the object was copied to during the current collection, if it
+    // has been
+    Object* forwarded;
+};
+
+struct Pair : Object {
+    TaggedValue car;
+    TaggedValue cdr;
+};
+
+// A function together with the values of the variables it captured, which
+// are copied into the closure when it is created and stored right after
+// it.
+struct Closure : Object {
+    // index of the function's first instruction
+    int entry;
+    int arity;
+    int num_captures;
+
+    TaggedValue* captures() { return reinterpret_cast<TaggedValue*>(this + 1); }
+
+    static constexpr size_t size_with(int num_captures) {
+        return sizeof(Closure) + num_captures * sizeof(TaggedValue);
+    }
+};
+
+static_assert(sizeof(Closure) % alignof(TaggedValue) == 0);
+
+// An integer that doesn't fit in a fixnum: the sign and digits of a Bignum,
+// with the digits stored right after it. BigInts are immutable, and the vm
+// only makes them for values outside the fixnum range, so each integer has
+// exactly one representation.
+struct BigInt : Object {
+    bool negative;
+    int num_digits;
+
+    uint32_t* digits() { return reinterpret_cast<uint32_t*>(this + 1); }
+    const uint32_t* digits() const {
+        return reinterpret_cast<const uint32_t*>(this + 1);
+    }
+
+    static constexpr size_t size_with(int num_digits) {
+        return sizeof(BigInt) + num_digits * sizeof(uint32_t);
+    }
+};
+
+inline TaggedValue TaggedValue::pair(Pair* pair) {
+    TaggedValue v;
+    v.typ = Type::Pair;
+    v.as.obj = pair;
+    return v;
+}
+
+inline TaggedValue TaggedValue::closure(Closure* closure) {
+    TaggedValue v;
+    v.typ = Type::Closure;
+    v.as.obj = closure;
+    return v;
+}
+
+inline TaggedValue TaggedValue::bigint(BigInt* bigint) {
+    TaggedValue v;
+    v.typ = Type::BigInt;
+    v.as.obj = bigint;
+    return v;
+}
+
+// Fixed-width little-endian encoding of the 32-bit ints that make up
+// instruction operands and chunk headers.
+void serialize_int32(int32_t x, std::vector<char>* buf);
+// overwrites the four bytes at |at|
+void serialize_int32(int32_t x, std::vector<char>* buf, int at);
+absl::StatusOr<int32_t> deserialize_int32(absl::Span<const char> buf, int at);
+
 class Value {
 public:
     virtual ~Value() {}
@@ -27,6 +173,7 @@ public:
     virtual std::string str() const = 0;
     virtual int value_size() const = 0;
     virtual std::unique_ptr<Value> clone() const = 0;
+    virtual TaggedValue unboxed() const = 0;
 
     void serialize(std::vector<char>* buf) const {
         buf->push_back(static_cast<char>(typ()));
@@ -34,7 +181,7 @@ public:
     }
 
     static absl::StatusOr<std::unique_ptr<Value>> deserialize(
-        const std::vector<char>& buf, int at);
+        absl::Span<const char> buf, int at);
 };
 
 class BoolValue final : public Value {
@@ -48,35 +195,54 @@ public:
     std::unique_ptr<Value> clone() const override {
         return std::make_unique<BoolValue>(value_);
     }
+    TaggedValue unboxed() const override {
+        return TaggedValue::boolean(value_);
+    }
 
     static constexpr Type static_typ = Type::Bool;
 
     static absl::StatusOr<std::unique_ptr<BoolValue>> deserialize(
-        const std::vector<char>& buf, int at);
+        absl::Span<const char> buf, int at);
 
 private:
     bool value_;
 };
 
+class NilValue final : public Value {
+public:
+    void serialize_value(std::vector<char>* buf) const override {}
+    int value_size() const override { return 0; }
+    Type typ() const override { return Type::Nil; }
+    std::string str() const override { return "nil"; }
+    std::unique_ptr<Value> clone() const override {
+        return std::make_unique<NilValue>();
+    }
+    TaggedValue unboxed() const override { return TaggedValue::nil(); }
+
+    static constexpr Type static_typ = Type::Nil;
+};
+
 class IntValue final : public Value {
 public:
-    IntValue(int value) : value_(value) {}
+    IntValue(int64_t value) : value_(value) {}
     void serialize_value(std::vector<char>* buf) const override;
-    void serialize_value(std::vector<char>* buf, int at) const;
-    int value_size() const override { return 4; }
+    int value_size() const override { return 8; }
     Type typ() const override { return Type::Int; }
     std::string str() const override { return std::to_string(value_); }
-    int value() const { return value_; }
+    int64_t value() const { return value_; }
     std::unique_ptr<Value> clone() const override {
         return std::make_unique<IntValue>(value_);
     }
+    TaggedValue unboxed() const override {
+        return TaggedValue::integer(value_);
+    }
 
     static constexpr Type static_typ = Type::Int;
 
     static absl::StatusOr<std::unique_ptr<IntValue>> deserialize(
-        const std::vector<char>& buf, int at);
+        absl::Span<const char> buf, int at);
 
 private:
-    int value_;
+    int64_t value_;
 };
 #endif  // VALUE_H_
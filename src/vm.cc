@@ -1,10 +1,21 @@
 #include "vm.h"
 
-#include <cassert>
+#include <algorithm>
+#include <utility>
 
+#include "absl/base/optimization.h"
 #include "absl/strings/str_format.h"
 #include "instr.h"
 
+// The interpreter core dispatches with computed gotos when the compiler
+// supports them. Build with --define dispatch=switch (which defines
+// JUNE_SWITCH_DISPATCH) to use the portable switch-based core instead.
+#if defined(__GNUC__) && !defined(JUNE_SWITCH_DISPATCH)
+#define JUNE_THREADED_DISPATCH 1
+#else
+#define JUNE_THREADED_DISPATCH 0
+#endif
+
 absl::Status VM::invalid(std::string_view message) const {
     return absl::InvalidArgumentError(
         absl::StrFormat("[pc=%d] vm: %s", instr_pc_, message));
@@ -15,112 +26,705 @@ absl::Status VM::type_error(Type want, Type got) const {
                                    to_string(want), to_string(got)));
 }
 
-absl::Status VM::check_type(const Value& value, Type want) const {
-    return value.typ() == want ? absl::OkStatus()
-                               : type_error(want, value.typ());
-}
-
 absl::Status VM::precondition_failed(std::string_view message) const {
     return absl::FailedPreconditionError(
         absl::StrFormat("[pc=%d] vm: %s", instr_pc_, message));
 }
 
-absl::Status VM::push() {
-    log("PUSH");
-    auto value = read_typed_static<Value>();
-    if (!value.ok()) return value.status();
-    log(absl::StrFormat(": [%s]", (*value)->str()));
-    stack_.push_back(*std::move(value));
-    return absl::OkStatus();
-}
-
-absl::Status VM::pop() {
-    log("POP");
-    auto val = pop_stack<Value>();
-    log(absl::StrFormat("-> [%s]", (*val)->str()));
-    return val.status();
-}
-
-absl::Status VM::print() {
-    log("PRINT");
-    if (stack_.empty()) return invalid("can't print empty stack");
-    absl::PrintF("%s\n", stack_.back()->str());
-    return absl::OkStatus();
-}
-
-absl::Status VM::jmp() {
-    log("JMP");
-    auto dest = read_static<IntValue>();
-    if (!dest.ok()) return dest.status();
-    log(absl::StrFormat(": [%s]", (*dest)->str()));
-    pc_ = (*dest)->value();
-    return absl::OkStatus();
-}
-
-absl::Status VM::jmp_if_not() {
-    log("JMP_IF_NOT");
-    auto dest = read_static<IntValue>();
-    if (!dest.ok()) return dest.status();
-    log(absl::StrFormat(": [%s]", (*dest)->str()));
-    auto cond = pop_stack<BoolValue>();
-    if (!cond.ok()) return cond.status();
-    log(absl::StrFormat("-> [%s]", (*cond)->str()));
-    if ((*cond)->value()) return absl::OkStatus();
-    pc_ = (*dest)->value();
-    return absl::OkStatus();
-}
-
-absl::Status VM::swap() {
-    log("SWAP");
-    auto val1 = pop_stack<Value>();
-    if (!val1.ok()) return val1.status();
-    log(absl::StrFormat("-> [%s]", (*val1)->str()));
-    auto val2 = pop_stack<Value>();
-    if (!val2.ok()) return val2.status();
-    log(absl::StrFormat("-> [%s]", (*val2)->str()));
-    push_stack(*std::move(val1));
-    push_stack(*std::move(val2));
-    return absl::OkStatus();
-}
-
-absl::Status VM::get() {
-    log("GET");
-    auto n = read_static<IntValue>();
-    if (!n.ok()) return n.status();
-    auto val = stack_get((*n)->value());
-    if (!val.has_value()) {
-        return absl::FailedPreconditionError("stack offset out of bounds");
-    }
-    push_stack(*std::move(val));
-    return absl::OkStatus();
-}
-
-absl::Status VM::step() {
-    log(absl::StrFormat("< stack: %d >", stack_size()));
-    instr_pc_ = pc_;
-    auto op = deserialize_opcode((*code_)[pc_++]);
-    if (!op.ok()) return invalid(op.status().message());
-    switch (*op) {
-        case Opcode::Push: return push();
-        case Opcode::Pop: return pop();
-        case Opcode::Print: return print();
-        case Opcode::Jmp: return jmp();
-        case Opcode::JmpIfNot: return jmp_if_not();
-        case Opcode::Swap: return swap();
-        case Opcode::Get: return get();
-    }
-    return invalid(absl::StrFormat("unsupported opcode: %d", *op));
+void VM::log(std::string_view msg) const {
+    absl::PrintF("%4d\t%s\n", instr_pc_, msg);
+}
+
+void VM::reserve_stack(int sp, int n) {
+    if (sp + n <= stack_.size()) return;
+    stack_.resize(std::max<size_t>(sp + n, 2 * stack_.size()));
 }
 
-void VM::log(std::string_view msg) const {
-    if (log_) absl::PrintF("%4d\t%s\n", instr_pc_, msg);
+void VM::collect(size_t size) {
+    heap_.collect(
+        [this](Heap::RootVisitor visit) {
+            for (int i = 0; i < sp_; i++) visit(&stack_[i]);
+            for (auto& global : globals_) visit(&global);
+            for (auto& [table, cache] : memo_) {
+                for (auto& result : cache.results()) visit(&result);
+            }
+        },
+        size);
+}
+
+std::string VM::global_name(int slot) const {
+    absl::Span<const std::string> names =
+        program_ != nullptr ? program_->global_names() : global_names_;
+    if (slot < names.size() && !names[slot].empty()) return names[slot];
+    return absl::StrFormat("%d", slot);
+}
+
+MemoCache& VM::memo_table(int table) {
+    return memo_.try_emplace(table, memo_capacity_).first->second;
+}
+
+MemoStats VM::memo_stats() const {
+    MemoStats total;
+    for (const auto& [table, cache] : memo_) {
+        total.hits += cache.stats().hits;
+        total.misses += cache.stats().misses;
+        total.evictions += cache.stats().evictions;
+        total.uncacheable += cache.stats().uncacheable;
+    }
+    return total;
+}
+
+namespace {
+Bignum to_bignum(TaggedValue v) {
+    if (v.typ == Type::Int) return Bignum(v.as.i);
+    const auto* big = static_cast<const BigInt*>(v.as.obj);
+    auto digits = absl::MakeConstSpan(big->digits(), big->num_digits);
+    return Bignum(big->negative, digits);
+}
+}  // namespace
+
+TaggedValue VM::make_integer(const Bignum& n) {
+    if (auto fixnum = n.to_int64()) return TaggedValue::integer(*fixnum);
+    const int num_digits = n.digits().size();
+    size_t size = BigInt::size_with(num_digits);
+    auto* big = heap_.try_allocate<BigInt>(Type::BigInt, size);
+    if (big == nullptr) {
+        collect(size);
+        big = heap_.try_allocate<BigInt>(Type::BigInt, size);
+    }
+    big->negative = n.negative();
+    big->num_digits = num_digits;
+    std::copy(n.digits().begin(), n.digits().end(), big->digits());
+    return TaggedValue::bigint(big);
+}
+
+TaggedValue VM::big_arithmetic(Opcode op, TaggedValue a, TaggedValue b) {
+    Bignum x = to_bignum(a), y = to_bignum(b);
+    switch (op) {
+        case Opcode::Add: return make_integer(x + y);
+        case Opcode::Sub: return make_integer(x - y);
+        default: return make_integer(x * y);
+    }
+}
+
+int VM::compare_integers(TaggedValue a, TaggedValue b) {
+    return compare(to_bignum(a), to_bignum(b));
+}
+
+JitState VM::jit_state(TaggedValue* base, TaggedValue* sp, int fp,
+                       TaggedValue* limit) {
+    auto native = jit_->native();
+    return JitState{
+        .sp = sp,
+        .base = base,
+        .fp = base + fp,
+        .limit = limit,
+        .globals = globals_.data(),
+        .frames = frames_.data(),
+        .num_frames = num_frames_,
+        .max_frames = static_cast<int32_t>(frames_.size()),
+        .native = native.data(),
+        .num_native = static_cast<int32_t>(native.size()),
+    };
+}
+
+// The handlers below keep the pc and the stack pointer in locals and only
+// write them back to the VM when leaving the loop. Each handler ends by
+// dispatching straight to the next one, and an absl::Status is only
+// constructed on the error paths at the bottom.
+//
+// Tracing and counting are compile-time policies: run<false, false>
+// contains no logging or counting code at all, and --log_vm and
+// set_count_instructions() select the separately instantiated loops.
+template <bool kTrace, bool kCount>
+absl::Status VM::run() {
+    const Instr* const code = code_.data();
+    const TaggedValue* const constants = constants_.data();
+    const NativeFunction* const natives =
+        natives_ != nullptr ? natives_->functions().data() : nullptr;
+    TaggedValue* base = stack_.data();
+    TaggedValue* sp = base + sp_;
+    TaggedValue* limit = base + stack_.size();
+    int pc = pc_;
+    int fp = fp_;
+    const Instr* instr = nullptr;
+    Type want_type, got_type;
+    int want_argc, got_argc;
+    absl::Status native_status;
+
+    // makes room for |n| more values, reloading the stack pointers if the
+    // stack had to grow
+#define RESERVE(n)                            \
+    if (limit - sp < (n)) {                   \
+        int depth = sp - base;                \
+        reserve_stack(depth, (n));            \
+        base = stack_.data();                 \
+        sp = base + depth;                    \
+        limit = base + stack_.size();         \
+    }
+#define TRACE(...)                                           \
+    if constexpr (kTrace) log(absl::StrFormat(__VA_ARGS__));
+#define FETCH()                                              \
+    instr = &code[pc++];                                     \
+    if constexpr (kCount) instructions_run_++;               \
+    if constexpr (kTrace) {                                  \
+        instr_pc_ = instr - code;                            \
+        log(absl::StrFormat("< stack: %d >", sp - base));    \
+        log(to_string(instr->op));                           \
+    }
+
+    // Switches to native code if the jit has compiled the instruction at
+    // pc, and resumes interpreting wherever the native code exits. This
+    // is only checked where the jit puts entry points: function entries
+    // and the instructions after ones that native code leaves to the
+    // interpreter.
+#define ENTER_JIT()                                                      \
+    if constexpr (!kTrace && !kCount) {                                  \
+        if (jit_ != nullptr) {                                           \
+            if (NativeCode native = jit_->enter(pc, code_, constants_)) { \
+                JitState state = jit_state(base, sp, fp, limit);         \
+                pc = native(&state);                                     \
+                sp = state.sp;                                           \
+                fp = state.fp - base;                                    \
+                num_frames_ = state.num_frames;                          \
+            }                                                            \
+        }                                                                \
+    }
+
+    // The integer handlers test for two fixnums first and only leave the
+    // fast path for bignums and overflow.
+#define FIXNUM_OPERANDS() \
+    ABSL_PREDICT_TRUE(sp[-2].typ == Type::Int && sp[-1].typ == Type::Int)
+    // checks that the top two values are integers of either kind
+#define CHECK_INTEGERS()                                                 \
+    if (!is_integer(sp[-2].typ) || !is_integer(sp[-1].typ)) {            \
+        want_type = Type::Int;                                           \
+        got_type = is_integer(sp[-2].typ) ? sp[-1].typ : sp[-2].typ;     \
+        goto type_error;                                                 \
+    }
+    // an arithmetic handler, with |checked| one of the overflow-checking
+    // builtins
+#define ARITHMETIC(op, checked)                                          \
+    TARGET(op) {                                                         \
+        if (sp - base < 2) goto stack_underflow;                         \
+        int64_t result;                                                  \
+        if (FIXNUM_OPERANDS() &&                                         \
+            !ABSL_PREDICT_FALSE(                                         \
+                checked(sp[-2].as.i, sp[-1].as.i, &result))) {           \
+            sp[-2].as.i = result;                                        \
+        } else {                                                         \
+            CHECK_INTEGERS();                                            \
+            sp_ = sp - base;                                             \
+            sp[-2] = big_arithmetic(Opcode::op, sp[-2], sp[-1]);         \
+        }                                                                \
+        --sp;                                                            \
+        TRACE(": [%s]", sp[-1].str());                                   \
+        DISPATCH();                                                      \
+    }
+    // compares the top two values, setting |result|
+#define COMPARE(cmp, result)                                             \
+    if (sp - base < 2) goto stack_underflow;                             \
+    if (FIXNUM_OPERANDS()) {                                             \
+        result = sp[-2].as.i cmp sp[-1].as.i;                            \
+    } else {                                                             \
+        CHECK_INTEGERS();                                                \
+        result = compare_integers(sp[-2], sp[-1]) cmp 0;                 \
+    }
+#define COMPARISON(op, fused, cmp)                                       \
+    TARGET(op) {                                                         \
+        bool result;                                                     \
+        COMPARE(cmp, result);                                            \
+        --sp;                                                            \
+        sp[-1] = TaggedValue::boolean(result);                           \
+        TRACE(": [%s]", sp[-1].str());                                   \
+        DISPATCH();                                                      \
+    }                                                                    \
+    TARGET(fused) {                                                      \
+        TRACE(": [%d]", instr->arg);                                     \
+        bool result;                                                     \
+        COMPARE(cmp, result);                                            \
+        sp -= 2;                                                         \
+        if (!result) pc = instr->arg;                                    \
+        DISPATCH();                                                      \
+    }
+
+#if JUNE_THREADED_DISPATCH
+    static const void* const kHandlers[] = {
+        &&bad_opcode,      &&op_Push,         &&op_Pop,          &&op_Print,
+        &&op_JmpIfNot,     &&op_Jmp,          &&op_Swap,         &&op_Get,
+        &&op_Halt,         &&op_Slide,        &&op_Get2,         &&op_GetGlobal,
+        &&op_SetGlobal,    &&op_Cons,         &&op_Car,          &&op_Cdr,
+        &&op_IsNil,        &&op_MakeClosure,  &&op_GetCapture,   &&op_Call,
+        &&op_Ret,          &&op_TailCall,     &&op_Add,          &&op_Sub,
+        &&op_Mul,          &&op_Lt,           &&op_Gt,           &&op_Eq,
+        &&op_JmpIfNotLt,   &&op_JmpIfNotGt,   &&op_JmpIfNotEq,
+        &&op_CallNative,   &&op_MemoGet,      &&op_MemoPut,
+    };
+#define DISPATCH()                                            \
+    FETCH();                                                  \
+    goto* kHandlers[static_cast<int>(instr->op)];
+#define TARGET(op) op_##op:
+#define DEFAULT_TARGET bad_opcode:
+    DISPATCH();
+#else
+#define DISPATCH() continue;
+#define TARGET(op) case Opcode::op:
+#define DEFAULT_TARGET default:
+    while (true) {
+        FETCH();
+        switch (instr->op) {
+#endif
+
+    TARGET(Push) {
+        RESERVE(1);
+        *sp = constants[instr->arg];
+        TRACE(": [%s]", sp->str());
+        sp++;
+        DISPATCH();
+    }
+
+    TARGET(Pop) {
+        if (sp == base) goto stack_underflow;
+        --sp;
+        TRACE("-> [%s]", sp->str());
+        DISPATCH();
+    }
+
+    TARGET(Print) {
+        if (sp == base) goto stack_underflow;
+        absl::Format(out_, "%s\n", sp[-1].str());
+        ENTER_JIT();
+        DISPATCH();
+    }
+
+    TARGET(JmpIfNot) {
+        TRACE(": [%d]", instr->arg);
+        if (sp == base) goto stack_underflow;
+        --sp;
+        TRACE("-> [%s]", sp->str());
+        if (sp->typ != Type::Bool) {
+            want_type = Type::Bool;
+            got_type = sp->typ;
+            goto type_error;
+        }
+        if (!sp->as.b) pc = instr->arg;
+        DISPATCH();
+    }
+
+    TARGET(Jmp) {
+        TRACE(": [%d]", instr->arg);
+        pc = instr->arg;
+        DISPATCH();
+    }
+
+    TARGET(Swap) {
+        if (sp - base < 2) goto stack_underflow;
+        TRACE("-> [%s]", sp[-1].str());
+        TRACE("-> [%s]", sp[-2].str());
+        std::swap(sp[-1], sp[-2]);
+        DISPATCH();
+    }
+
+    TARGET(Get) {
+        int n = instr->arg;
+        if (n < 0 || fp + n >= sp - base) goto bad_offset;
+        RESERVE(1);
+        *sp = base[fp + n];
+        TRACE(": [%s]", sp->str());
+        sp++;
+        DISPATCH();
+    }
+
+    TARGET(Get2) {
+        int n = instr->arg, m = instr->arg2;
+        // m can name the slot that the first get pushes, as in Get n; Get m
+        int locals = (sp - base) - fp;
+        if (n < 0 || n >= locals || m < 0 || m > locals) goto bad_offset;
+        RESERVE(2);
+        sp[0] = base[fp + n];
+        sp[1] = base[fp + m];
+        sp += 2;
+        DISPATCH();
+    }
+
+    TARGET(Slide) {
+        int n = instr->arg;
+        if (n < 0 || n >= sp - base) goto stack_underflow;
+        TRACE(": [%d]", n);
+        sp[-n - 1] = sp[-1];
+        sp -= n;
+        DISPATCH();
+    }
+
+    TARGET(GetGlobal) {
+        const TaggedValue& global = globals_[instr->arg];
+        if (global.typ == kUndefined) goto undefined_global;
+        RESERVE(1);
+        *sp = global;
+        TRACE(": [%s]", sp->str());
+        sp++;
+        ENTER_JIT();
+        DISPATCH();
+    }
+
+    TARGET(SetGlobal) {
+        if (sp == base) goto stack_underflow;
+        --sp;
+        TRACE("-> [%s]", sp->str());
+        globals_[instr->arg] = *sp;
+        ENTER_JIT();
+        DISPATCH();
+    }
+
+    TARGET(Cons) {
+        if (sp - base < 2) goto stack_underflow;
+        auto* pair = heap_.try_allocate<Pair>(Type::Pair);
+        if (pair == nullptr) {
+            // the operands are still on the stack, so they survive
+            sp_ = sp - base;
+            collect(sizeof(Pair));
+            pair = heap_.try_allocate<Pair>(Type::Pair);
+        }
+        pair->car = sp[-2];
+        pair->cdr = sp[-1];
+        --sp;
+        sp[-1] = TaggedValue::pair(pair);
+        TRACE(": [%s]", sp[-1].str());
+        ENTER_JIT();
+        DISPATCH();
+    }
+
+    TARGET(Car) {
+        if (sp == base) goto stack_underflow;
+        if (sp[-1].typ != Type::Pair) {
+            want_type = Type::Pair;
+            got_type = sp[-1].typ;
+            goto type_error;
+        }
+        sp[-1] = static_cast<Pair*>(sp[-1].as.obj)->car;
+        DISPATCH();
+    }
+
+    TARGET(Cdr) {
+        if (sp == base) goto stack_underflow;
+        if (sp[-1].typ != Type::Pair) {
+            want_type = Type::Pair;
+            got_type = sp[-1].typ;
+            goto type_error;
+        }
+        sp[-1] = static_cast<Pair*>(sp[-1].as.obj)->cdr;
+        DISPATCH();
+    }
+
+    TARGET(IsNil) {
+        if (sp == base) goto stack_underflow;
+        sp[-1] = TaggedValue::boolean(sp[-1].typ == Type::Nil);
+        DISPATCH();
+    }
+
+    TARGET(MakeClosure) {
+        int count = instr->arg3;
+        if (sp - base < count) goto stack_underflow;
+        size_t size = Closure::size_with(count);
+        auto* closure = heap_.try_allocate<Closure>(Type::Closure, size);
+        if (closure == nullptr) {
+            // the captured values are still on the stack, so they survive
+            sp_ = sp - base;
+            collect(size);
+            closure = heap_.try_allocate<Closure>(Type::Closure, size);
+        }
+        closure->entry = instr->arg;
+        closure->arity = instr->arg2;
+        closure->num_captures = count;
+        std::copy(sp - count, sp, closure->captures());
+        sp -= count;
+        RESERVE(1);
+        *sp++ = TaggedValue::closure(closure);
+        ENTER_JIT();
+        DISPATCH();
+    }
+
+    TARGET(GetCapture) {
+        int n = instr->arg;
+        if (fp == 0 || base[fp - 1].typ != Type::Closure) goto bad_offset;
+        auto* closure = static_cast<Closure*>(base[fp - 1].as.obj);
+        if (n < 0 || n >= closure->num_captures) goto bad_offset;
+        RESERVE(1);
+        *sp = closure->captures()[n];
+        TRACE(": [%s]", sp->str());
+        sp++;
+        ENTER_JIT();
+        DISPATCH();
+    }
+
+    TARGET(Call) {
+        int argc = instr->arg;
+        TRACE(": [%d]", argc);
+        if (argc < 0 || sp - base < argc + 1) goto stack_underflow;
+        const TaggedValue& callee = sp[-argc - 1];
+        if (callee.typ != Type::Closure) {
+            want_type = Type::Closure;
+            got_type = callee.typ;
+            goto type_error;
+        }
+        auto* closure = static_cast<Closure*>(callee.as.obj);
+        if (closure->arity != argc) {
+            want_argc = closure->arity;
+            got_argc = argc;
+            goto bad_arity;
+        }
+        if (num_frames_ == frames_.size()) {
+            if (num_frames_ == kMaxFrames) goto stack_overflow;
+            frames_.resize(
+                std::clamp<size_t>(2 * num_frames_, 64, kMaxFrames));
+        }
+        frames_[num_frames_++] = Frame{.pc = pc, .fp = fp};
+        fp = (sp - base) - argc;
+        pc = closure->entry;
+        ENTER_JIT();
+        DISPATCH();
+    }
+
+    TARGET(TailCall) {
+        int argc = instr->arg;
+        TRACE(": [%d]", argc);
+        if (argc < 0 || sp - base < argc + 1) goto stack_underflow;
+        if (num_frames_ == 0) goto stack_underflow;
+        const TaggedValue& callee = sp[-argc - 1];
+        if (callee.typ != Type::Closure) {
+            want_type = Type::Closure;
+            got_type = callee.typ;
+            goto type_error;
+        }
+        auto* closure = static_cast<Closure*>(callee.as.obj);
+        if (closure->arity != argc) {
+            want_argc = closure->arity;
+            got_argc = argc;
+            goto bad_arity;
+        }
+        // move the closure and its arguments down over the current frame,
+        // which keeps its return pc and caller
+        std::copy(sp - argc - 1, sp, base + fp - 1);
+        sp = base + fp + argc;
+        pc = closure->entry;
+        ENTER_JIT();
+        DISPATCH();
+    }
+
+    TARGET(Ret) {
+        if (num_frames_ == 0 || sp - base <= fp) goto stack_underflow;
+        TRACE("-> [%s]", sp[-1].str());
+        // the result replaces the closure
+        base[fp - 1] = sp[-1];
+        sp = base + fp;
+        const Frame& frame = frames_[--num_frames_];
+        pc = frame.pc;
+        fp = frame.fp;
+        ENTER_JIT();
+        DISPATCH();
+    }
+
+    ARITHMETIC(Add, __builtin_add_overflow)
+    ARITHMETIC(Sub, __builtin_sub_overflow)
+    ARITHMETIC(Mul, __builtin_mul_overflow)
+    COMPARISON(Lt, JmpIfNotLt, <)
+    COMPARISON(Gt, JmpIfNotGt, >)
+    COMPARISON(Eq, JmpIfNotEq, ==)
+
+    // Native functions read their arguments where they are on the stack and
+    // write their result over the first one. They can't allocate, so sp_
+    // doesn't need to be up to date.
+    TARGET(CallNative) {
+        const NativeFunction& native = natives[instr->arg];
+        const int argc = instr->arg2;
+        if (sp - base < argc) goto stack_underflow;
+        RESERVE(1);
+        TaggedValue* args = sp - argc;
+        native_status = native.thunk(native.fn.get(), args);
+        if (!native_status.ok()) goto native_failed;
+        sp = args + 1;
+        TRACE(": [%s]", args->str());
+        ENTER_JIT();
+        DISPATCH();
+    }
+
+    // A memoized function's arguments are the first slots of its frame,
+    // and stay there until it returns since its calls are never tail
+    // calls.
+    TARGET(MemoGet) {
+        if (fp == 0 || base[fp - 1].typ != Type::Closure) goto bad_offset;
+        const auto* closure = static_cast<Closure*>(base[fp - 1].as.obj);
+        MemoCache& cache = memo_table(instr->arg2);
+        if (const TaggedValue* hit = cache.find(
+                absl::MakeConstSpan(base + fp, closure->arity))) {
+            RESERVE(1);
+            *sp++ = *hit;
+            TRACE(": hit [%s]", hit->str());
+            pc = instr->arg;
+            DISPATCH();
+        }
+        ENTER_JIT();
+        DISPATCH();
+    }
+
+    TARGET(MemoPut) {
+        if (fp == 0 || base[fp - 1].typ != Type::Closure) goto bad_offset;
+        const auto* closure = static_cast<Closure*>(base[fp - 1].as.obj);
+        if (sp - base <= fp + closure->arity) goto stack_underflow;
+        memo_table(instr->arg)
+            .insert(absl::MakeConstSpan(base + fp, closure->arity), sp[-1]);
+        DISPATCH();
+    }
+
+    TARGET(Halt) {
+        pc_ = pc - 1;
+        sp_ = sp - base;
+        fp_ = fp;
+        return absl::OkStatus();
+    }
+
+    DEFAULT_TARGET {
+        instr_pc_ = instr - code;
+        return invalid(
+            absl::StrFormat("bad opcode: %d", static_cast<int>(instr->op)));
+    }
+
+#if !JUNE_THREADED_DISPATCH
+        }
+    }
+#endif
+
+#undef RESERVE
+#undef ENTER_JIT
+#undef FIXNUM_OPERANDS
+#undef CHECK_INTEGERS
+#undef ARITHMETIC
+#undef COMPARE
+#undef COMPARISON
+#undef TRACE
+#undef FETCH
+#undef DISPATCH
+#undef TARGET
+#undef DEFAULT_TARGET
+
+stack_underflow:
+    instr_pc_ = instr - code;
+    sp_ = sp - base;
+    return invalid("stack underflow");
+
+type_error:
+    instr_pc_ = instr - code;
+    sp_ = sp - base;
+    return type_error(want_type, got_type);
+
+bad_offset:
+    instr_pc_ = instr - code;
+    sp_ = sp - base;
+    return precondition_failed("stack offset out of bounds");
+
+bad_arity:
+    instr_pc_ = instr - code;
+    sp_ = sp - base;
+    return invalid(absl::StrFormat("wrong number of arguments: want %d, got %d",
+                                   want_argc, got_argc));
+
+stack_overflow:
+    instr_pc_ = instr - code;
+    sp_ = sp - base;
+    return invalid("stack overflow");
+
+undefined_global:
+    instr_pc_ = instr - code;
+    sp_ = sp - base;
+    return invalid(absl::StrFormat("global %s is not defined",
+                                   global_name(instr->arg)));
+
+native_failed:
+    instr_pc_ = instr - code;
+    sp_ = sp - base;
+    // keep the code the native function failed with
+    return absl::Status(
+        native_status.code(),
+        absl::StrFormat("[pc=%d] vm: %s: %s", instr_pc_,
+                        natives[instr->arg].name, native_status.message()));
+}
+
+absl::Status VM::execute(ChunkView chunk) {
+    auto constants = load_constants(chunk.constants);
+    if (!constants.ok()) return constants.status();
+    auto instrs = decode(chunk.code);
+    if (!instrs.ok()) return instrs.status();
+    return append_and_run(*std::move(constants), *std::move(instrs),
+                          chunk.globals);
+}
+
+absl::Status VM::execute(std::vector<TaggedValue> constants,
+                         std::vector<Instr> code) {
+    return append_and_run(std::move(constants), std::move(code), {});
+}
+
+absl::Status VM::append_and_run(std::vector<TaggedValue> constants,
+                                std::vector<Instr> code,
+                                absl::Span<const char> global_names) {
+    if (program_ != nullptr) {
+        return absl::FailedPreconditionError("vm: already running a program");
+    }
+    auto num_globals =
+        validate(code, constants.size(), natives_, globals_.size());
+    if (!num_globals.ok()) return num_globals.status();
+    auto globals = load_global_names(global_names, *num_globals);
+    if (!globals.ok()) return globals.status();
+
+    // append the chunk, rebasing its constant indices and jump targets
+    const int constant_base = loaded_constants_.size();
+    const int code_base = loaded_code_.size();
+    for (auto& instr : code) {
+        if (instr.op == Opcode::Push) instr.arg += constant_base;
+        else if (has_target(instr.op)) instr.arg += code_base;
+    }
+    loaded_constants_.insert(loaded_constants_.end(), constants.begin(),
+                             constants.end());
+    loaded_code_.insert(loaded_code_.end(), code.begin(), code.end());
+    loaded_code_.push_back(Instr{.op = Opcode::Halt});
+    code_ = loaded_code_;
+    constants_ = loaded_constants_;
+    globals_.resize(*num_globals, TaggedValue{.typ = kUndefined});
+    if (global_names_.size() < globals_.size()) {
+        global_names_.resize(globals_.size());
+    }
+    std::move(globals->names.begin(), globals->names.end(),
+              global_names_.begin() + globals->first);
+    return run_from(code_base);
+}
+
+absl::Status VM::execute(std::shared_ptr<const Program> program) {
+    // the jit's counters and native code are indexed by pc, so they are
+    // only valid for the code they were collected on
+    if (!loaded_code_.empty() ||
+        (program_ != nullptr && program_ != program)) {
+        return absl::FailedPreconditionError("vm: already running other code");
+    }
+    program_ = std::move(program);
+    code_ = program_->code();
+    constants_ = program_->constants();
+    natives_ = program_->natives();
+    if (globals_.size() < program_->num_globals()) {
+        globals_.resize(program_->num_globals(),
+                        TaggedValue{.typ = kUndefined});
+    }
+    return run_from(0);
 }
 
-absl::Status VM::execute(const std::vector<char>& code) {
-    pc_ = 0;
-    code_ = &code;
-    while (pc_ < code.size()) {
-        if (auto status = step(); !status.ok()) return status;
+absl::Status VM::run_from(int pc) {
+    pc_ = pc;
+    auto status = log_                 ? run<true, false>()
+                  : count_instructions_ ? run<false, true>()
+                                        : run<false, false>();
+    // drop whatever the failed statement left on the stack
+    if (!status.ok()) {
+        sp_ = 0;
+        fp_ = 0;
+        num_frames_ = 0;
     }
-    return absl::OkStatus();
+    return status;
 }
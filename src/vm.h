@@ -1,86 +1,154 @@
 #ifndef VM_H_
 #define VM_H_
 
-#include <optional>
-#include <type_traits>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "bignum.h"
+#include "chunk.h"
+#include "heap.h"
+#include "instr.h"
+#include "jit.h"
+#include "memo.h"
+#include "native.h"
+#include "program.h"
 #include "value.h"
 
+// The VM keeps everything it has loaded: each executed chunk is appended to
+// a persistent code segment and constant pool and only the new code runs,
+// so globals and code from earlier chunks stay available to later ones.
+// Alternatively a VM can run a shared Program, whose code and constants it
+// reads in place; such a VM runs only that program.
+//
+// Calls don't recurse on the native stack. Each call pushes a Frame that
+// records where to return to, and the callee's locals live on the value
+// stack above its frame pointer:
+//
+//     [closure] [arg 0] ... [arg n-1] [let bindings and temporaries] ...
+//               ^ fp
 class VM final {
 public:
-    absl::Status execute(const std::vector<char>& code);
+    // maximum depth of nested calls
+    static constexpr int kMaxFrames = 1 << 20;
+    static constexpr int kDefaultMemoCapacity = 1 << 16;
+
+    // loads the constant pool and decodes the code of |chunk| once up front
+    // and then runs the decoded instructions
+    absl::Status execute(ChunkView chunk);
+    absl::Status execute(std::vector<TaggedValue> constants,
+                         std::vector<Instr> code);
+    // runs |program| from its start, keeping the globals that earlier runs
+    // of it defined. Fails if the VM has run any other code.
+    absl::Status execute(std::shared_ptr<const Program> program);
     void set_log(bool log) { log_ = log; }
+    // Counts the instructions that run, for benchmarks. Counting runs a
+    // separately instantiated interpreter loop, and keeps the jit from
+    // running code natively so that every instruction is counted.
+    void set_count_instructions(bool count) { count_instructions_ = count; }
+    // the instructions run while counting was on
+    int64_t instructions_run() const { return instructions_run_; }
+    // the native functions that executed chunks call, which must outlive
+    // the VM. Programs bring their own.
+    void set_natives(const Natives* natives) { natives_ = natives; }
+    // Print writes to |out|, which must outlive the VM
+    void set_output(std::ostream* out) { out_ = out; }
+    const HeapStats& heap_stats() const { return heap_.stats(); }
+    // runs hot code natively, if the platform supports it
+    void set_jit(bool jit) {
+        jit_ = jit && Jit::supported() ? std::make_unique<Jit>() : nullptr;
+    }
+    JitStats jit_stats() const { return jit_ ? jit_->stats() : JitStats{}; }
+    // the most results each memoized function keeps, which applies to the
+    // functions first called after it's set
+    void set_memo_capacity(int capacity) { memo_capacity_ = capacity; }
+    // totals over all memoized functions
+    MemoStats memo_stats() const;
 
 private:
     absl::Status invalid(std::string_view message) const;
     absl::Status type_error(Type want, Type got) const;
-    absl::Status check_type(const Value& value, Type want) const;
     absl::Status precondition_failed(std::string_view message) const;
+    // the name of global |slot| if its chunk named it, otherwise its number
+    std::string global_name(int slot) const;
     void log(std::string_view message) const;
 
-    // executive the next instruction
-    absl::Status step();
+    // the interpreter loop: runs from pc_ until Halt or an error, printing
+    // each instruction if |kTrace| is set and counting them if |kCount| is
+    template <bool kTrace, bool kCount>
+    absl::Status run();
+    // validates |code| and appends it, along with |constants| and the
+    // serialized GlobalNames of the globals it adds, to what the VM has
+    // loaded, then runs it
+    absl::Status append_and_run(std::vector<TaggedValue> constants,
+                                std::vector<Instr> code,
+                                absl::Span<const char> global_names);
+    // runs from |pc|, dropping whatever a failed statement left on the stack
+    absl::Status run_from(int pc);
 
-    template <typename T>
-    absl::StatusOr<std::unique_ptr<T>> downcast(std::unique_ptr<Value> value) {
-        Value* base = value.get();
-        T* derived = dynamic_cast<T*>(base);
-        if (derived == nullptr) return type_error(T::static_typ, base->typ());
-        return std::unique_ptr<T>(dynamic_cast<T*>(value.release()));
-    }
+    // grows the stack so that at least |n| more values fit above the |sp|
+    // first values
+    void reserve_stack(int sp, int n);
 
-    // pop the next value from the stack
-    template <typename T>
-    absl::StatusOr<std::unique_ptr<T>> pop_stack() {
-        if (stack_.empty()) return invalid("can't pop empty stack");
-        auto value = std::move(stack_.back());
-        stack_.pop_back();
-        if constexpr (std::is_base_of<T, Value>()) return value;
-        else return downcast<T>(std::move(value));
-    }
-    void push_stack(std::unique_ptr<Value> value) {
-        stack_.push_back(std::move(value));
-    }
-    size_t stack_size() const { return stack_.size(); }
-    std::optional<std::unique_ptr<Value>> stack_get(int n) {
-        if (n < 0 || n >= stack_.size()) return {};
-        int k = stack_.size() - n - 1;
-        return stack_[k]->clone();
-    }
+    // collects garbage, treating the stack below sp_ and the globals as
+    // roots, so that at least |size| bytes can be allocated
+    void collect(size_t size);
 
-    // read the next static value from code
-    template <typename T>
-    absl::StatusOr<std::unique_ptr<T>> read_typed_static() {
-        auto value = Value::deserialize(*code_, pc_);
-        if (value.ok()) pc_ += (*value)->size();
-        if constexpr (std::is_base_of<T, Value>()) return value;
-        else return downcast<T>(std::move(value.value()));
-    }
-    template <typename T>
-    absl::StatusOr<std::unique_ptr<T>> read_static() {
-        auto value = T::deserialize(*code_, pc_);
-        if (value.ok()) pc_ += (*value)->value_size();
-        return value;
-    }
+    // The slow paths of the integer opcodes, taken when an operand is a
+    // bignum or a result doesn't fit in a fixnum. |a| and |b| must be
+    // integers, and sp_ must be up to date since these can allocate.
+    TaggedValue big_arithmetic(Opcode op, TaggedValue a, TaggedValue b);
+    static int compare_integers(TaggedValue a, TaggedValue b);
+    // |n| as a fixnum if it fits, otherwise as a new BigInt
+    TaggedValue make_integer(const Bignum& n);
+
+    // the cache for memo table |table|, created when it's first used
+    MemoCache& memo_table(int table);
 
-    // opcode handlers
-    absl::Status push();
-    absl::Status pop();
-    absl::Status print();
-    absl::Status jmp();
-    absl::Status jmp_if_not();
-    absl::Status swap();
-    absl::Status get();
+    // the state native code starts from, given the interpreter's registers
+    JitState jit_state(TaggedValue* base, TaggedValue* sp, int fp,
+                       TaggedValue* limit);
 
     bool log_ = false;
+    bool count_instructions_ = false;
+    int64_t instructions_run_ = 0;
+    std::ostream* out_ = &std::cout;
     int instr_pc_ = 0;
     int pc_ = 0;
-    const std::vector<char>* code_ = nullptr;
+    // the code and constants being run: either loaded_code_ and
+    // loaded_constants_, where executed chunks are appended, or program_'s
+    absl::Span<const Instr> code_;
+    absl::Span<const TaggedValue> constants_;
+    std::vector<Instr> loaded_code_;
+    std::vector<TaggedValue> loaded_constants_;
+    std::shared_ptr<const Program> program_;
+    const Natives* natives_ = nullptr;
+    // kUndefined until the slot's define has run
+    std::vector<TaggedValue> globals_;
+    // names of the globals of executed chunks, by slot
+    std::vector<std::string> global_names_;
+    Heap heap_;
+    // null unless the jit is enabled
+    std::unique_ptr<Jit> jit_;
+    // keyed by table number, which the compiler assigns
+    absl::flat_hash_map<int, MemoCache> memo_;
+    int memo_capacity_ = kDefaultMemoCapacity;
 
-    // TODO: keep the values directly in the stack, not via pointers
-    std::vector<std::unique_ptr<Value>> stack_;
+    // values live in stack_[0, sp_); the rest of stack_ is spare capacity
+    std::vector<TaggedValue> stack_;
+    int sp_ = 0;
+    // start of the current frame's locals in stack_; 0 at the top level
+    int fp_ = 0;
+    // the active calls are frames_[0, num_frames_); the rest of frames_ is
+    // spare capacity, which native code can push to
+    std::vector<Frame> frames_;
+    int num_frames_ = 0;
 };
 
 #endif  // VM_H_
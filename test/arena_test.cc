@@ -0,0 +1,86 @@
+#include "src/arena.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+template <typename T>
+bool aligned(const T* p) {
+    return reinterpret_cast<uintptr_t>(p) % alignof(T) == 0;
+}
+
+struct alignas(32) Wide {
+    char bytes[40];
+};
+
+TEST(ArenaTest, AlignsObjects) {
+    Arena arena;
+    for (int i = 0; i < 100; i++) {
+        // misalign the next allocation before each one
+        arena.make<char>('x');
+        EXPECT_TRUE(aligned(arena.make<int64_t>(i)));
+        arena.make<char>('y');
+        EXPECT_TRUE(aligned(arena.make<double>(i)));
+        const Wide* wide = arena.make<Wide>();
+        EXPECT_TRUE(aligned(wide));
+    }
+    int64_t* p = arena.make<int64_t>(42);
+    EXPECT_EQ(*p, 42);
+}
+
+TEST(ArenaTest, CopiesSpans) {
+    Arena arena;
+    std::vector<int> items = {1, 2, 3, 4};
+    absl::Span<const int> copy = arena.copy(absl::MakeConstSpan(items));
+    items.assign(4, 0);
+    EXPECT_EQ(std::vector<int>(copy.begin(), copy.end()),
+              (std::vector<int>{1, 2, 3, 4}));
+    EXPECT_TRUE(aligned(copy.data()));
+    EXPECT_TRUE(arena.copy(absl::Span<const int>()).empty());
+
+    std::string text = "hello";
+    std::string_view s = arena.copy(std::string_view(text));
+    text[0] = 'j';
+    EXPECT_EQ(s, "hello");
+}
+
+TEST(ArenaTest, AllocatesLargeBlocks) {
+    Arena arena;
+    arena.make<char>('x');
+    // much bigger than the first block, which has to be set aside
+    std::vector<int64_t> big(100000, 7);
+    absl::Span<const int64_t> copy = arena.copy(absl::MakeConstSpan(big));
+    ASSERT_EQ(copy.size(), big.size());
+    EXPECT_TRUE(aligned(copy.data()));
+    EXPECT_EQ(copy.front(), 7);
+    EXPECT_EQ(copy.back(), 7);
+    EXPECT_GE(arena.bytes_reserved(), big.size() * sizeof(int64_t));
+
+    // later allocations still work, in the big block or a new one
+    EXPECT_EQ(*arena.make<int>(5), 5);
+}
+
+TEST(ArenaTest, MovesAllocations) {
+    Arena arena;
+    int* p = arena.make<int>(1);
+    const size_t reserved = arena.bytes_reserved();
+
+    Arena moved(std::move(arena));
+    // the memory now belongs to |moved|, so it stays valid
+    EXPECT_EQ(*p, 1);
+    EXPECT_EQ(moved.bytes_reserved(), reserved);
+    EXPECT_EQ(*moved.make<int>(2), 2);
+
+    // and the source starts over empty
+    EXPECT_EQ(arena.bytes_reserved(), 0);
+    EXPECT_EQ(*arena.make<int>(3), 3);
+    EXPECT_EQ(*p, 1);
+}
+
+}  // namespace
@@ -0,0 +1,41 @@
+#include "src/bignum.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+namespace {
+
+TEST(BignumTest, RoundTripsFixnums) {
+    for (int64_t n : {int64_t{0}, int64_t{1}, int64_t{-1}, int64_t{1} << 32,
+                      INT64_MAX, INT64_MIN}) {
+        EXPECT_EQ(Bignum(n).to_int64(), n);
+        EXPECT_EQ(Bignum(n).str(), std::to_string(n));
+    }
+}
+
+TEST(BignumTest, Arithmetic) {
+    Bignum max(INT64_MAX), min(INT64_MIN), one(1);
+    EXPECT_EQ((max + one).str(), "9223372036854775808");
+    EXPECT_EQ((max + one).to_int64(), std::nullopt);
+    EXPECT_EQ((min - one).str(), "-9223372036854775809");
+    EXPECT_EQ((max * max).str(), "85070591730234615847396907784232501249");
+    EXPECT_EQ((min * min).str(), "85070591730234615865843651857942052864");
+    EXPECT_EQ((max * min).str(), "-85070591730234615856620279821087277056");
+    EXPECT_EQ((max + one - one).to_int64(), INT64_MAX);
+    EXPECT_EQ((Bignum(1000000000) * Bignum(1000000000)).str(),
+              "1000000000000000000");
+    EXPECT_EQ((max * Bignum(0)).str(), "0");
+}
+
+TEST(BignumTest, Compare) {
+    Bignum big = Bignum(INT64_MAX) * Bignum(4);
+    EXPECT_GT(compare(big, Bignum(INT64_MAX)), 0);
+    EXPECT_LT(compare(Bignum(0) - big, Bignum(INT64_MIN)), 0);
+    EXPECT_EQ(compare(big, Bignum(INT64_MAX) + Bignum(INT64_MAX) +
+                               Bignum(INT64_MAX) + Bignum(INT64_MAX)),
+              0);
+    EXPECT_LT(compare(Bignum(-2), Bignum(1)), 0);
+}
+
+}  // namespace
@@ -0,0 +1,119 @@
+#include "src/cgen.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "src/evaluator.h"
+#include "src/instr.h"
+
+namespace {
+
+// evaluates |text| interactively as a single chunk and returns everything
+// it printed, followed by the error that stopped it, if any
+std::string evaluate(std::string_view text) {
+    std::ostringstream out;
+    Evaluator eval([&out](absl::Status status) {
+        out << status.message() << "\n";
+    });
+    eval.set_interactive(true);
+    eval.set_optimize(true);
+    eval.set_output(&out);
+    eval.evaluate(text);
+    return out.str();
+}
+
+std::string read(const std::string& path) {
+    std::ifstream is(path);
+    std::stringstream buf;
+    buf << is.rdbuf();
+    return buf.str();
+}
+
+bool have_cc() { return std::system("cc --version >/dev/null 2>&1") == 0; }
+
+// compiles |text| to C, builds it with the system compiler and returns what
+// the program printed to stdout and stderr
+std::string build_and_run(std::string_view text) {
+    Evaluator eval([](absl::Status status) { ADD_FAILURE() << status; });
+    eval.set_interactive(true);
+    eval.set_optimize(true);
+    auto chunk = eval.compile(text);
+    EXPECT_TRUE(chunk.ok()) << chunk.status();
+    if (!chunk.ok()) return "";
+    auto program = emit_c(chunk->view());
+    EXPECT_TRUE(program.ok()) << program.status();
+    if (!program.ok()) return "";
+
+    const char* tmp = std::getenv("TEST_TMPDIR");
+    std::string dir = tmp != nullptr ? tmp : "/tmp";
+    std::string src = dir + "/cgen_test.c", bin = dir + "/cgen_test";
+    std::string out = dir + "/cgen_test.out";
+    std::ofstream(src) << *program;
+    std::string build = "cc -O2 -o " + bin + " " + src;
+    EXPECT_EQ(std::system(build.c_str()), 0) << build;
+    std::system((bin + " >" + out + " 2>&1").c_str());
+    return read(out);
+}
+
+// checks that the native program prints what the vm does
+void expect_same(std::string_view text) {
+    EXPECT_EQ(build_and_run(text), evaluate(text)) << text;
+}
+
+TEST(CgenTest, SameResults) {
+    if (!have_cc()) GTEST_SKIP() << "no C compiler";
+    expect_same("1 #t #f -7 nil");
+    expect_same("(let ((x 1) (y 2)) (let ((z 3)) (if (< x y) z x)))");
+    expect_same(
+        "(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))\n"
+        "(fib 20)\n"
+        "fib");
+    expect_same(
+        "(define (range n acc) (if (= n 0) acc "
+        "(range (- n 1) (cons n acc))))\n"
+        "(range 10 nil)\n"
+        "(cons 1 (cons 2 3))\n"
+        "(car (cdr (range 100000 nil)))");
+    expect_same(
+        "(define (adder x) (lambda (y) (+ x y)))\n"
+        "(define add3 (adder 3))\n"
+        "(add3 4)\n"
+        "((adder 10) -20)");
+}
+
+TEST(CgenTest, Bignums) {
+    if (!have_cc()) GTEST_SKIP() << "no C compiler";
+    expect_same(
+        "(define (fact n) (if (= n 0) 1 (* n (fact (- n 1)))))\n"
+        "(fact 20) (fact 21) (fact 50)\n"
+        "(- 0 (fact 30))\n"
+        "(- (fact 30) (fact 30))\n"
+        "(+ 9223372036854775807 1)\n"
+        "(- -9223372036854775807 2)\n"
+        "(< (fact 30) (fact 31)) (> (fact 30) 5) (= (fact 25) (fact 25))\n"
+        "123456789012345678901234567890");
+}
+
+TEST(CgenTest, SameErrors) {
+    if (!have_cc()) GTEST_SKIP() << "no C compiler";
+    expect_same("1 (car 5) 2");
+    expect_same("(+ 1 #t)");
+    expect_same("(define (f x) x) (f 1 2)");
+    expect_same("(define (f x) x) (1 2)");
+    expect_same("(define (deep n) (if (= n 0) 0 (+ 1 (deep (- n 1)))))\n"
+                "(deep 1000)\n"
+                "(deep 2000000)");
+}
+
+TEST(CgenTest, RejectsBadChunks) {
+    Chunk chunk;
+    serialize_opcode(Opcode::Push, &chunk.code);
+    serialize_int32(3, &chunk.code);
+    EXPECT_FALSE(emit_c(chunk.view()).ok());
+}
+
+}  // namespace
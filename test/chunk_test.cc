@@ -0,0 +1,80 @@
+#include "src/chunk.h"
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+Chunk make_chunk() {
+    Chunk chunk;
+    IntValue(42).serialize(&chunk.constants);
+    BoolValue(true).serialize(&chunk.constants);
+    chunk.code = {1, 0, 0, 0, 0, 2};
+    serialize_global_names(GlobalNames{.first = 2, .names = {"x", "fib"}},
+                           &chunk.globals);
+    return chunk;
+}
+
+TEST(ChunkTest, RoundTrip) {
+    Chunk chunk = make_chunk();
+    auto bytes = serialize_chunk(chunk);
+    auto view = deserialize_chunk(bytes);
+    ASSERT_TRUE(view.ok()) << view.status();
+    EXPECT_EQ(std::vector<char>(view->constants.begin(), view->constants.end()),
+              chunk.constants);
+    EXPECT_EQ(std::vector<char>(view->code.begin(), view->code.end()),
+              chunk.code);
+    EXPECT_EQ(std::vector<char>(view->globals.begin(), view->globals.end()),
+              chunk.globals);
+
+    auto constants = load_constants(view->constants);
+    ASSERT_TRUE(constants.ok());
+    ASSERT_EQ(constants->size(), 2);
+    EXPECT_EQ((*constants)[0].as.i, 42);
+    EXPECT_EQ((*constants)[1].as.b, true);
+
+    auto globals = load_global_names(view->globals, 4);
+    ASSERT_TRUE(globals.ok());
+    EXPECT_EQ(globals->first, 2);
+    EXPECT_EQ(globals->names, (std::vector<std::string>{"x", "fib"}));
+}
+
+TEST(ChunkTest, RejectsGlobalNamesPastTheCode) {
+    std::vector<char> globals;
+    serialize_global_names(GlobalNames{.first = 2, .names = {"x", "fib"}},
+                           &globals);
+    EXPECT_TRUE(load_global_names(globals, 4).ok());
+    EXPECT_TRUE(load_global_names(globals, 5).ok());
+    EXPECT_FALSE(load_global_names(globals, 3).ok());
+    EXPECT_FALSE(load_global_names(globals, 1).ok());
+    // an empty section names nothing, whatever the code uses
+    EXPECT_TRUE(load_global_names({}, 0).ok());
+
+    // a hostile first slot mustn't make anyone allocate that many names
+    globals.clear();
+    serialize_global_names(
+        GlobalNames{.first = std::numeric_limits<int32_t>::max(),
+                    .names = {"x"}},
+        &globals);
+    EXPECT_FALSE(load_global_names(globals, 4).ok());
+    EXPECT_FALSE(
+        load_global_names(globals, std::numeric_limits<int32_t>::max()).ok());
+}
+
+TEST(ChunkTest, RejectsCorruptFiles) {
+    auto bytes = serialize_chunk(make_chunk());
+    for (int i = 0; i < bytes.size(); i++) {
+        auto corrupt = bytes;
+        corrupt[i] ^= 0x10;
+        EXPECT_FALSE(deserialize_chunk(corrupt).ok()) << "byte " << i;
+    }
+    for (int n = 0; n < bytes.size(); n++) {
+        std::vector<char> truncated(bytes.begin(), bytes.begin() + n);
+        EXPECT_FALSE(deserialize_chunk(truncated).ok()) << "length " << n;
+    }
+}
+
+}  // namespace
@@ -0,0 +1,57 @@
+#include "src/compiler.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "src/instr.h"
+#include "src/parser.h"
+#include "src/scanner.h"
+
+namespace {
+
+std::vector<Instr> compile(std::string_view text) {
+    SymbolTable symbols;
+    auto toks = scan(text, &symbols);
+    EXPECT_TRUE(toks.ok());
+    Arena arena;
+    auto stmts = parse(*toks, &arena);
+    EXPECT_TRUE(stmts.ok());
+    auto chunk = Compiler().compile(*stmts);
+    EXPECT_TRUE(chunk.ok()) << chunk.status();
+    auto code = decode(chunk->code);
+    EXPECT_TRUE(code.ok());
+    return *code;
+}
+
+int count(const std::vector<Instr>& code, Opcode op) {
+    return std::count_if(code.begin(), code.end(),
+                         [op](const Instr& instr) { return instr.op == op; });
+}
+
+TEST(CompilerTest, TailCallsInArms) {
+    auto code = compile("(lambda (f x) (if x (f x) (f (f x))))");
+    EXPECT_EQ(count(code, Opcode::TailCall), 2);
+    EXPECT_EQ(count(code, Opcode::Call), 1);
+}
+
+TEST(CompilerTest, TailCallsInLetBody) {
+    auto code = compile("(lambda (f) (let ((x (f 1))) (f x)))");
+    EXPECT_EQ(count(code, Opcode::TailCall), 1);
+    EXPECT_EQ(count(code, Opcode::Call), 1);
+}
+
+TEST(CompilerTest, NoTailCallsOutsideFunctions) {
+    auto code = compile("(define (f x) x) (f 1) (if #t (f 2) (f 3))");
+    EXPECT_EQ(count(code, Opcode::TailCall), 0);
+    EXPECT_EQ(count(code, Opcode::Call), 3);
+}
+
+TEST(CompilerTest, NoTailCallsInConditionsOrArguments) {
+    auto code = compile("(lambda (f) (if (f 1) (cons (f 2) nil) ((f 3) 4)))");
+    EXPECT_EQ(count(code, Opcode::TailCall), 1);
+    EXPECT_EQ(count(code, Opcode::Call), 3);
+}
+
+}  // namespace
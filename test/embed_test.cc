@@ -0,0 +1,109 @@
+#include "src/embed.h"
+
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "src/chunk.h"
+#include "src/instr.h"
+#include "src/parallel.h"
+#include "src/program.h"
+
+namespace {
+
+constexpr char kFib[] =
+    "(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))\n"
+    "(define (fact n) (if (= n 0) 1 (* n (fact (- n 1)))))\n"
+    "(fib 20)\n"
+    "(fact 25)\n";
+constexpr char kFibOutput[] = "6765\n15511210043330985984000000\n";
+
+std::shared_ptr<const Program> compile_or_die(std::string_view text) {
+    auto program = compile_program(text, {.interactive = true});
+    EXPECT_TRUE(program.ok()) << program.status();
+    return program.ok() ? *program : nullptr;
+}
+
+TEST(EmbedTest, RunsProgram) {
+    auto program = compile_or_die(kFib);
+    ASSERT_NE(program, nullptr);
+    std::ostringstream out;
+    Isolate isolate(program);
+    isolate.set_output(&out);
+    ASSERT_TRUE(isolate.run().ok());
+    EXPECT_EQ(out.str(), kFibOutput);
+
+    // running again starts over with the globals still defined
+    ASSERT_TRUE(isolate.run().ok());
+    EXPECT_EQ(out.str(), std::string(kFibOutput) + kFibOutput);
+}
+
+TEST(EmbedTest, SharesProgramAcrossThreads) {
+    auto program = compile_or_die(kFib);
+    ASSERT_NE(program, nullptr);
+    constexpr int kIsolates = 32;
+    std::vector<std::string> outputs(kIsolates);
+    std::vector<bool> ok(kIsolates);
+    std::vector<std::function<void()>> tasks;
+    for (int i = 0; i < kIsolates; i++) {
+        tasks.push_back([&, i] {
+            std::ostringstream out;
+            Isolate isolate(program);
+            isolate.set_output(&out);
+            isolate.set_jit(i % 2 == 0);
+            ok[i] = isolate.run().ok();
+            outputs[i] = out.str();
+        });
+    }
+    run_parallel(4, std::move(tasks));
+    for (int i = 0; i < kIsolates; i++) {
+        EXPECT_TRUE(ok[i]) << i;
+        EXPECT_EQ(outputs[i], kFibOutput) << i;
+    }
+}
+
+TEST(EmbedTest, ReportsErrors) {
+    EXPECT_FALSE(compile_program("(define").ok());
+
+    auto program = compile_or_die("1 (car 5) 2");
+    ASSERT_NE(program, nullptr);
+    std::ostringstream out;
+    Isolate isolate(program);
+    isolate.set_output(&out);
+    EXPECT_FALSE(isolate.run().ok());
+    EXPECT_FALSE(isolate.run().ok());
+    EXPECT_EQ(out.str(), "1\n1\n");
+}
+
+TEST(EmbedTest, RejectsBadChunks) {
+    Chunk chunk;
+    serialize_opcode(Opcode::Push, &chunk.code);
+    serialize_int32(3, &chunk.code);
+    EXPECT_FALSE(Program::load(chunk.view()).ok());
+
+    // names for globals that the code doesn't use
+    chunk.code.clear();
+    serialize_global_names(GlobalNames{.first = 1 << 30, .names = {"x"}},
+                           &chunk.globals);
+    EXPECT_FALSE(Program::load(chunk.view()).ok());
+}
+
+TEST(EmbedTest, VMRunsOnlyOneProgram) {
+    auto program = compile_or_die("1");
+    auto other = compile_or_die("2");
+    ASSERT_NE(program, nullptr);
+    ASSERT_NE(other, nullptr);
+    std::ostringstream out;
+    VM vm;
+    vm.set_output(&out);
+    EXPECT_TRUE(vm.execute(program).ok());
+    EXPECT_TRUE(vm.execute(program).ok());
+    EXPECT_FALSE(vm.execute(other).ok());
+    EXPECT_FALSE(vm.execute(Chunk{}.view()).ok());
+    EXPECT_EQ(out.str(), "1\n1\n");
+}
+
+}  // namespace
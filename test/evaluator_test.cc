@@ -1,5 +1,41 @@
+#include "src/evaluator.h"
+
 #include <gtest/gtest.h>
 
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// evaluates each of |lines| in turn with the same evaluator, like the repl
+// does, and returns everything it printed
+std::string evaluate_lines(const std::vector<std::string>& lines) {
+    std::ostringstream out;
+    Evaluator eval([&out](absl::Status status) {
+        out << "error: " << status.message() << "\n";
+    });
+    eval.set_interactive(true);
+    eval.set_output(&out);
+    for (const auto& line : lines) eval.evaluate(line);
+    return out.str();
+}
+
+// runs |text| as a script, and returns everything it printed
+std::string run_script(std::string_view text) {
+    std::ostringstream out;
+    Evaluator eval([&out](absl::Status status) {
+        out << "error: " << status.message() << "\n";
+    });
+    eval.set_interactive(true);
+    eval.set_output(&out);
+    eval.run_script(text);
+    return out.str();
+}
+
+}  // namespace
+
 // Demonstrate some basic assertions.
 TEST(HelloTest, BasicAssertions) {
     // Expect two strings not to be equal.
@@ -7,3 +43,226 @@ TEST(HelloTest, BasicAssertions) {
     // Expect equality.
     EXPECT_EQ(7 * 6, 42);
 }
+
+TEST(EvaluatorTest, GlobalsSurviveBetweenLines) {
+    EXPECT_EQ(evaluate_lines({
+                  "(define x 5)",
+                  "(define y (let ((a #t)) a))",
+                  "(if y x 0)",
+                  "(define x 7)",
+                  "x",
+              }),
+              "5\n7\n");
+}
+
+TEST(EvaluatorTest, OnlyNewStatementsRun) {
+    EXPECT_EQ(evaluate_lines({"1 2", "3", "(let ((a 4)) a)"}),
+              "1\n2\n3\n4\n");
+}
+
+TEST(EvaluatorTest, FailedCompileDefinesNothing) {
+    std::string out = evaluate_lines({"(define x 1) (define y z)", "x"});
+    EXPECT_NE(out.find("z is not defined"), std::string::npos);
+    EXPECT_NE(out.find("x is not defined"), std::string::npos);
+}
+
+TEST(EvaluatorTest, FailedLineDoesNotBreakLaterLines) {
+    std::string out = evaluate_lines({
+        "(define x (if 1 2 3))",
+        "(define y 2)",
+        "(let ((a y)) (if a 1 2))",
+        "y",
+    });
+    EXPECT_NE(out.find("type error"), std::string::npos);
+    EXPECT_EQ(out.substr(out.rfind('\n', out.size() - 2) + 1), "2\n");
+}
+
+TEST(EvaluatorTest, UndefinedGlobalsAreNamed) {
+    std::string out = evaluate_lines({
+        "(define x 1) (define y (car 5))",
+        "(let ((a x)) y)",
+    });
+    EXPECT_NE(out.find("vm: global y is not defined"), std::string::npos);
+}
+
+TEST(EvaluatorTest, Lists) {
+    EXPECT_EQ(evaluate_lines({
+                  "(define xs (cons 1 (cons #t (cons nil nil))))",
+                  "xs",
+                  "(car (cdr xs))",
+                  "(nil? (cdr (cdr (cdr xs))))",
+                  "(let ((a 1) (b 2)) (cons a b))",
+              }),
+              "(1 true nil)\ntrue\ntrue\n(1 . 2)\n");
+}
+
+TEST(EvaluatorTest, ListsSurviveCollection) {
+    std::vector<std::string> lines = {"(define xs nil)"};
+    for (int i = 0; i < 20000; i++) {
+        lines.push_back("(define xs (cons (cons 1 nil) (cdr (cons 0 xs))))");
+    }
+    lines.push_back("(car (car (cdr xs)))");
+    EXPECT_EQ(evaluate_lines(lines), "1\n");
+}
+
+TEST(EvaluatorTest, Functions) {
+    EXPECT_EQ(evaluate_lines({
+                  "(define (twice f x) (f (f x)))",
+                  "(twice (lambda (xs) (cons 0 xs)) nil)",
+                  "((lambda (x y) (cons y x)) 1 2)",
+              }),
+              "(0 0)\n(2 . 1)\n");
+}
+
+TEST(EvaluatorTest, ClosuresCaptureValues) {
+    EXPECT_EQ(evaluate_lines({
+                  "(define (adder x) (lambda (y) (cons x y)))",
+                  "(define add1 (adder 1))",
+                  "(add1 2)",
+                  "(let ((a 1) (b 2)) ((lambda (c) (cons a (cons b c))) 3))",
+                  "((((lambda (x) (lambda (y) (lambda (z) (cons x z)))) 1) 2) "
+                  "3)",
+              }),
+              "(1 . 2)\n(1 2 . 3)\n(1 . 3)\n");
+}
+
+TEST(EvaluatorTest, Recursion) {
+    EXPECT_EQ(evaluate_lines({
+                  "(define (last xs) (if (nil? (cdr xs)) (car xs) "
+                  "(last (cdr xs))))",
+                  "(last (cons 1 (cons 2 (cons 3 nil))))",
+              }),
+              "3\n");
+}
+
+TEST(EvaluatorTest, BadCalls) {
+    std::string out = evaluate_lines({
+        "(define (id x) x)",
+        "(id 1 2)",
+        "(1 2)",
+        "(define (loop x) (cons (loop x) x))",
+        "(loop 1)",
+        "(id 3)",
+    });
+    EXPECT_NE(out.find("wrong number of arguments"), std::string::npos);
+    EXPECT_NE(out.find("want Closure, got Int"), std::string::npos);
+    EXPECT_NE(out.find("stack overflow"), std::string::npos);
+    EXPECT_EQ(out.substr(out.rfind('\n', out.size() - 2) + 1), "3\n");
+}
+
+TEST(EvaluatorTest, ClosuresSurviveCollection) {
+    std::vector<std::string> lines = {
+        "(define (wrap x) (lambda () x))",
+        "(define (unwrap-all fs) (if (nil? fs) nil "
+        "(cons ((car fs)) (unwrap-all (cdr fs)))))",
+        "(define fs nil)",
+    };
+    for (int i = 0; i < 20000; i++) {
+        lines.push_back("(define fs (cons (wrap (cons 1 nil)) fs))");
+    }
+    lines.push_back("(car (unwrap-all (cdr fs)))");
+    EXPECT_EQ(evaluate_lines(lines), "(1)\n");
+}
+
+TEST(EvaluatorTest, TailCallsRunInConstantSpace) {
+    // builds a list of 2^20 ones by doubling, then walks it with more
+    // recursive calls than the vm allows frames
+    std::string twenty = "nil";
+    for (int i = 0; i < 20; i++) twenty = "(cons 1 " + twenty + ")";
+    EXPECT_EQ(evaluate_lines({
+                  "(define (double xs acc) (if (nil? xs) acc "
+                  "(double (cdr xs) (cons 1 (cons 1 acc)))))",
+                  "(define (grow xs n) (if (nil? n) xs "
+                  "(grow (double xs nil) (cdr n))))",
+                  "(define xs (grow (cons 1 nil) " + twenty + "))",
+                  "(define (reverse xs acc) (if (nil? xs) acc "
+                  "(reverse (cdr xs) (cons (car xs) acc))))",
+                  "(define (last xs) (let ((rest (cdr xs))) "
+                  "(if (nil? rest) (car xs) (last rest))))",
+                  "(last (reverse xs nil))",
+              }),
+              "1\n");
+}
+
+TEST(EvaluatorTest, Arithmetic) {
+    EXPECT_EQ(evaluate_lines({
+                  "(define (fib n) (if (< n 2) n "
+                  "(+ (fib (- n 1)) (fib (- n 2)))))",
+                  "(fib 20)",
+                  "(let ((x 6) (y 7)) (cons (* x y) (- x y)))",
+                  "(cons (= 1 1) (cons (> 1 2) (< 1 2)))",
+              }),
+              "6765\n(42 . -1)\n(true false . true)\n");
+}
+
+TEST(EvaluatorTest, BadArithmetic) {
+    std::string out = evaluate_lines({
+        "(< 1 nil)",
+        "(* (* 4294967296 4294967296) #t)",
+        "(- 3 1)",
+    });
+    EXPECT_NE(out.find("want Int, got Nil"), std::string::npos);
+    EXPECT_NE(out.find("want Int, got Bool"), std::string::npos);
+    EXPECT_EQ(out.substr(out.rfind('\n', out.size() - 2) + 1), "2\n");
+}
+
+TEST(EvaluatorTest, BignumPromotion) {
+    EXPECT_EQ(evaluate_lines({
+                  "(define max 9223372036854775807)",
+                  "(+ max 1)",
+                  "(- (- 0 max) 2)",
+                  "(- (+ max 1) 1)",
+                  "(= (+ max 1) (+ 1 max))",
+                  "(< max (+ max 1))",
+                  "(> (- 0 max) (* max max))",
+                  "123456789012345678901234567890",
+                  "-123456789012345678901234567890",
+              }),
+              "9223372036854775808\n"
+              "-9223372036854775809\n"
+              "9223372036854775807\n"
+              "true\ntrue\nfalse\n"
+              "123456789012345678901234567890\n"
+              "-123456789012345678901234567890\n");
+}
+
+TEST(EvaluatorTest, BignumsSurviveCollection) {
+    // each 2^128 is built by doubling, so the sum allocates enough
+    // intermediate bignums to need several collections
+    EXPECT_EQ(evaluate_lines({
+                  "(define (pow2 n acc) (if (= n 0) acc "
+                  "(pow2 (- n 1) (* acc 2))))",
+                  "(define (sum n acc) (if (= n 0) acc "
+                  "(sum (- n 1) (+ acc (pow2 128 1)))))",
+                  "(sum 20000 0)",
+              }),
+              "6805647338418769269267492148635364229120000\n");
+}
+
+TEST(EvaluatorTest, ScriptsRunOneStatementAtATime) {
+    const std::string text =
+        "(define (f x)\n"
+        "  (if (< x 1) nil (cons x (f (- x 1)))))\n"
+        "(f 3) 7 #t\n"
+        "(define g (lambda (y) (+ y 1))) (g 41)\n";
+    EXPECT_EQ(run_script(text), evaluate_lines({text}));
+    EXPECT_EQ(run_script(text), "(3 2 1)\n7\ntrue\n42\n");
+    EXPECT_EQ(run_script(""), "");
+    EXPECT_EQ(run_script("  \n"), "");
+}
+
+TEST(EvaluatorTest, ScriptsStopAtTheFirstError) {
+    // statements before the error have already run, while the ones after
+    // it, and even the bad token itself, were never scanned
+    std::string out = run_script("1 (+ 1 1)\n(car 3) 4");
+    EXPECT_EQ(out.substr(0, 4), "1\n2\n");
+    EXPECT_NE(out.find("type error"), std::string::npos);
+    EXPECT_EQ(out.find("4\n"), std::string::npos);
+
+    out = run_script("1\n2\n(+ 1 $)");
+    EXPECT_EQ(out.substr(0, 4), "1\n2\n");
+    EXPECT_NE(out.find("[line 3] scanner"), std::string::npos);
+
+    EXPECT_NE(run_script("1 (+ 1").find("unexpected eof"), std::string::npos);
+    EXPECT_NE(run_script(") 1").find("parser"), std::string::npos);
+}
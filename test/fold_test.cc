@@ -0,0 +1,75 @@
+#include "src/fold.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "src/parser.h"
+#include "src/scanner.h"
+
+namespace {
+
+std::string fold(std::string_view text) {
+    SymbolTable symbols;
+    Arena arena;
+    auto toks = scan(text, &symbols);
+    EXPECT_TRUE(toks.ok());
+    auto stmts = parse(*toks, &arena);
+    EXPECT_TRUE(stmts.ok());
+    std::string s;
+    for (const auto& stmt : fold(*stmts, &arena)) s += to_string(stmt);
+    return s;
+}
+
+TEST(FoldTest, PicksLiveArm) {
+    EXPECT_EQ(fold("(if #t 1 2)"), "1");
+    EXPECT_EQ(fold("(if #f 1 2)"), "2");
+    EXPECT_EQ(fold("(if (if #f #t #f) 1 (if #t 3 4))"), "3");
+}
+
+TEST(FoldTest, PropagatesConstantBindings) {
+    EXPECT_EQ(fold("(let ((debug #f)) (if debug 1 2))"), "2");
+    EXPECT_EQ(fold("(let ((x 1) (y x)) y)"), "1");
+    EXPECT_EQ(fold("(let ((x #t)) (let ((x 5)) x))"), "5");
+}
+
+TEST(FoldTest, DropsUnusedBindings) {
+    EXPECT_EQ(fold("(let ((x 1) (y 2)) (let ((z 3)) z))"), "3");
+    EXPECT_EQ(fold("(let ((a 1)) (let ((x (if a 1 2)) (y x) (z y)) y))"),
+              "Let([x -> If(1, 1, 2)][y -> Symbol(x)])");
+}
+
+TEST(FoldTest, KeepsBindingsThatCanFail) {
+    // undefined names, globals whose define may have failed, and native
+    // functions, which can only be called, are errors even when unused
+    EXPECT_EQ(fold("(let ((x undefined-thing)) 1)"),
+              "Let([x -> Symbol(undefined-thing)])");
+    EXPECT_EQ(fold("(define y (car 5)) (let ((x y)) 1)"),
+              "Define(y, Builtin(car, 5))Let([x -> Symbol(y)])");
+    EXPECT_EQ(fold("(let ((x square)) 1)"), "Let([x -> Symbol(square)])");
+    EXPECT_EQ(fold("(lambda (y) (let ((x y)) 1))"), "Lambda([y], 1)");
+}
+
+TEST(FoldTest, PropagatesIntoFunctions) {
+    EXPECT_EQ(fold("(let ((k #t)) (lambda (x) (if k x 0)))"),
+              "Lambda([x], Symbol(x))");
+    EXPECT_EQ(fold("(let ((x 1)) (lambda (x) x))"), "Lambda([x], Symbol(x))");
+    EXPECT_EQ(fold("(let ((f 1)) (lambda (x) (f x)))"),
+              "Lambda([x], Call(1, Symbol(x)))");
+}
+
+TEST(FoldTest, FoldsArithmetic) {
+    EXPECT_EQ(fold("(let ((x 6)) (* x (+ 3 4)))"), "42");
+    EXPECT_EQ(fold("(if (< 1 2) (if (= 1 2) 3 4) 5)"), "4");
+    EXPECT_EQ(fold("(let ((x 2147483647)) (+ x 1))"), "2147483648");
+    EXPECT_EQ(fold("(let ((x 9223372036854775807)) (+ x 1))"),
+              "Builtin(+, 9223372036854775807, 1)");
+    EXPECT_EQ(fold("(lambda (x) (- x (- 3 2)))"),
+              "Lambda([x], Builtin(-, Symbol(x), 1))");
+}
+
+TEST(FoldTest, KeepsNonConstantConditions) {
+    EXPECT_EQ(fold("(let ((a 1)) (if a 1 2))"), "If(1, 1, 2)");
+}
+
+}  // namespace
@@ -0,0 +1,105 @@
+#include "src/heap.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace {
+
+// allocates pairs in a heap, collecting with |roots_| as the only roots
+class HeapTest : public ::testing::Test {
+protected:
+    Heap heap_{1024};
+    std::vector<TaggedValue> roots_;
+
+    void collect(size_t size = 0) {
+        heap_.collect(
+            [this](Heap::RootVisitor visit) {
+                for (auto& root : roots_) visit(&root);
+            },
+            size);
+    }
+
+    TaggedValue cons(TaggedValue car, TaggedValue cdr) {
+        auto* pair = heap_.try_allocate<Pair>(Type::Pair);
+        if (pair == nullptr) {
+            roots_.push_back(car);
+            roots_.push_back(cdr);
+            collect(sizeof(Pair));
+            cdr = roots_.back();
+            roots_.pop_back();
+            car = roots_.back();
+            roots_.pop_back();
+            pair = heap_.try_allocate<Pair>(Type::Pair);
+        }
+        pair->car = car;
+        pair->cdr = cdr;
+        return TaggedValue::pair(pair);
+    }
+
+    // (n-1 ... 1 0)
+    TaggedValue list(int n) {
+        roots_.push_back(TaggedValue::nil());
+        for (int i = 0; i < n; i++) {
+            TaggedValue tail = roots_.back();
+            roots_.pop_back();
+            roots_.push_back(cons(TaggedValue::integer(i), tail));
+        }
+        TaggedValue list = roots_.back();
+        roots_.pop_back();
+        return list;
+    }
+};
+
+TEST_F(HeapTest, AllocatesUntilFull) {
+    int count = 0;
+    while (heap_.try_allocate<Pair>(Type::Pair) != nullptr) count++;
+    EXPECT_GT(count, 0);
+    EXPECT_EQ(heap_.stats().bytes_allocated, 1024 - heap_.bytes_free());
+    EXPECT_EQ(heap_.stats().collections, 0);
+}
+
+TEST_F(HeapTest, CollectFreesGarbage) {
+    while (heap_.try_allocate<Pair>(Type::Pair) != nullptr) {
+    }
+    collect();
+    EXPECT_EQ(heap_.stats().collections, 1);
+    EXPECT_EQ(heap_.stats().bytes_live, 0);
+    EXPECT_EQ(heap_.bytes_free(), heap_.capacity());
+}
+
+TEST_F(HeapTest, CollectKeepsReachableObjects) {
+    TaggedValue tail = cons(TaggedValue::boolean(true), TaggedValue::nil());
+    roots_.push_back(cons(TaggedValue::integer(1), tail));
+    for (int i = 0; i < 100; i++) {
+        cons(TaggedValue::integer(i), TaggedValue::nil());
+    }
+    collect();
+    EXPECT_EQ(roots_[0].str(), "(1 true)");
+    EXPECT_EQ(heap_.stats().bytes_live, 2 * sizeof(Pair));
+}
+
+TEST_F(HeapTest, SharedObjectsAreCopiedOnce) {
+    TaggedValue shared = cons(TaggedValue::integer(1), TaggedValue::nil());
+    roots_.push_back(cons(shared, shared));
+    collect();
+    auto* pair = static_cast<Pair*>(roots_[0].as.obj);
+    EXPECT_EQ(pair->car.as.obj, pair->cdr.as.obj);
+    EXPECT_EQ(heap_.stats().bytes_live, 2 * sizeof(Pair));
+}
+
+TEST_F(HeapTest, GrowsToFitLiveObjects) {
+    roots_.push_back(list(1000));
+    EXPECT_GT(heap_.capacity(), 1000 * sizeof(Pair));
+    EXPECT_GT(heap_.stats().collections, 0);
+    TaggedValue value = roots_[0];
+    for (int i = 999; i >= 0; i--) {
+        ASSERT_EQ(value.typ, Type::Pair);
+        auto* pair = static_cast<Pair*>(value.as.obj);
+        ASSERT_EQ(pair->car.as.i, i);
+        value = pair->cdr;
+    }
+    EXPECT_EQ(value.typ, Type::Nil);
+}
+
+}  // namespace
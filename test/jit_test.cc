@@ -0,0 +1,236 @@
+#include "src/jit.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "absl/strings/str_format.h"
+#include "src/evaluator.h"
+#include "src/native.h"
+#include "src/vm.h"
+
+namespace {
+
+struct Result {
+    std::string output;
+    JitStats stats;
+};
+
+// evaluates each of |lines| interactively and returns everything printed,
+// including errors without their pc, which native code doesn't track
+Result evaluate(const std::vector<std::string>& lines, bool jit,
+                bool optimize = true) {
+    std::ostringstream out;
+    Evaluator eval([&out](absl::Status status) {
+        std::string message(status.message());
+        message.erase(0, message.find(' ') + 1);
+        out << "error: " << message << "\n";
+    });
+    eval.set_interactive(true);
+    eval.set_optimize(optimize);
+    eval.set_jit(jit);
+    eval.set_output(&out);
+    for (const auto& line : lines) eval.evaluate(line);
+    return Result{.output = out.str(), .stats = eval.jit_stats()};
+}
+
+// checks that |lines| behave the same with and without the jit
+void expect_same(const std::vector<std::string>& lines) {
+    for (bool optimize : {false, true}) {
+        Result interpreted = evaluate(lines, false, optimize);
+        Result compiled = evaluate(lines, true, optimize);
+        EXPECT_EQ(interpreted.output, compiled.output)
+            << lines.back() << (optimize ? " (optimized)" : "");
+    }
+}
+
+const char kFib[] =
+    "(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))";
+const char kSum[] =
+    "(define (sum n acc) (if (= n 0) acc (sum (- n 1) (+ acc n))))";
+
+TEST(JitTest, CompilesHotFunctions) {
+    if (!Jit::supported()) GTEST_SKIP();
+    Result result = evaluate({kFib, "(fib 20)"}, true);
+    EXPECT_EQ(result.output, "6765\n");
+    EXPECT_GT(result.stats.regions, 0);
+    // once compiled, calls and returns stay in native code
+    EXPECT_GT(result.stats.entries, 0);
+    EXPECT_LT(result.stats.entries, 10);
+    // cold code is never compiled
+    result = evaluate({kFib, "(fib 2)"}, true);
+    EXPECT_EQ(result.stats.regions, 0);
+}
+
+TEST(JitTest, SameResults) {
+    expect_same({kFib, "(fib 20)", "(fib 25)"});
+    expect_same({kSum, "(sum 100000 0)"});
+    expect_same({
+        "(define (tri n) (if (= n 0) 0 (let ((m n)) (+ m (tri (- m 1))))))",
+        "(tri 1000)",
+    });
+    expect_same({
+        "(define (count xs n) (if (nil? xs) n (count (cdr xs) (+ n 1))))",
+        "(define (range n acc) (if (= n 0) acc "
+        "(range (- n 1) (cons n acc))))",
+        "(count (range 1000 nil) 0)",
+        "(car (cdr (range 100 nil)))",
+    });
+    expect_same({
+        "(define (adder x) (lambda (y) (+ x y)))",
+        "(define (apply-n f n x) (if (= n 0) x (apply-n f (- n 1) (f x))))",
+        "(apply-n (adder 3) 1000 0)",
+    });
+    expect_same({
+        "(define (f a b c) (let ((x (* a b)) (y (- b c))) "
+        "(if (> x y) (let ((z (+ x y))) (- z a)) (if (= x y) 0 c))))",
+        "(define (loop n acc) (if (< n 0) acc "
+        "(loop (- n 1) (+ acc (f n (- n 3) (* n 2))))))",
+        "(loop 500 0)",
+    });
+}
+
+TEST(JitTest, SideExits) {
+    // overflow and type errors in hot code go back to the interpreter
+    expect_same({kSum, "(sum 100000 9223372036854775000)"});
+    expect_same({"(define (fact n acc) (if (= n 0) acc "
+                 "(fact (- n 1) (* acc n))))",
+                 "(fact 10 1)", "(fact 30 1)", "(fact 100 1)"});
+    expect_same({kFib, "(fib 15)", "(fib #t)", "(fib nil)", "(fib 10)"});
+    expect_same({
+        "(define (bad n) (if (= n 0) (car n) (bad (- n 1))))",
+        "(bad 100)",
+        "(define (deep n) (if (= n 0) 0 (+ 1 (deep (- n 1)))))",
+        "(deep 100)",
+        "(deep 2000000)",
+        "(deep 10)",
+    });
+    expect_same({
+        "(define (f n) (if (= n 0) g (f (- n 1))))",
+        "(f 100)",
+        "(define g 1)",
+        "(f 100)",
+        "(define g (lambda (x) x))",
+        "(f 100)",
+    });
+    expect_same({
+        "(define (g x) (if x 1 2))",
+        "(define (h n) (if (= n 0) (g n) (h (- n 1))))",
+        "(h 100)",
+    });
+}
+
+TEST(JitTest, ReentersAfterNativeCalls) {
+    if (!Jit::supported()) GTEST_SKIP();
+    Natives natives;
+    ASSERT_TRUE(natives.define("square", [](int64_t x) { return x * x; }).ok());
+    std::ostringstream out;
+    Evaluator eval([](absl::Status status) { ADD_FAILURE() << status; });
+    eval.set_interactive(true);
+    eval.set_optimize(true);
+    eval.set_jit(true);
+    eval.set_natives(&natives);
+    eval.set_output(&out);
+    eval.evaluate(
+        "(define (squares n acc) (if (= n 0) acc "
+        "(squares (- n 1) (cons (square n) acc))))");
+    eval.evaluate("(car (squares 1000 nil))");
+    EXPECT_EQ(out.str(), "1\n");
+    // Each iteration leaves native code twice, for the call to square and
+    // for the Cons, and goes straight back in after each of them
+    // instead of interpreting the rest of the loop.
+    EXPECT_GT(eval.jit_stats().entries, 2 * (1000 - Jit::kHotThreshold));
+}
+
+TEST(JitTest, CountingRunsEveryInstruction) {
+    Evaluator eval([](absl::Status status) { ADD_FAILURE() << status; });
+    auto count = [&](int n, bool jit) {
+        auto chunk = eval.compile(
+            absl::StrFormat("%s\n(sum %d 0)", kSum, n));
+        if (!chunk.ok()) return int64_t{-1};
+        VM vm;
+        vm.set_jit(jit);
+        vm.set_count_instructions(true);
+        std::ostringstream out;
+        vm.set_output(&out);
+        EXPECT_TRUE(vm.execute(chunk->view()).ok());
+        EXPECT_EQ(vm.jit_stats().entries, 0);
+        return vm.instructions_run();
+    };
+    // the loop runs a fixed number of instructions per iteration, all of
+    // them in the interpreter
+    int64_t base = count(0, false);
+    int64_t step = count(1, false) - base;
+    EXPECT_GT(step, 0);
+    EXPECT_EQ(count(1000, false), base + 1000 * step);
+    EXPECT_EQ(count(1000, true), base + 1000 * step);
+}
+
+// Generates random functions of integer arithmetic, comparisons, ifs and
+// lets, which are called enough times to be compiled.
+class ProgramGenerator {
+public:
+    explicit ProgramGenerator(int seed) : rng_(seed) {}
+
+    std::vector<std::string> program() {
+        std::vector<std::string> lines = {
+            absl::StrFormat("(define (f a b) %s)", int_expr(4, 2)),
+            "(define (loop n acc) (if (= n 0) acc "
+            "(loop (- n 1) (cons (f n (- 0 n)) acc))))",
+        };
+        for (int i = 0; i < 3; i++) {
+            lines.push_back(absl::StrFormat("(loop %d nil)", pick(1, 60)));
+        }
+        return lines;
+    }
+
+private:
+    int pick(int lo, int hi) {
+        return std::uniform_int_distribution<int>(lo, hi)(rng_);
+    }
+
+    std::string int_expr(int depth, int vars) {
+        if (depth == 0 || pick(0, 4) == 0) {
+            int choice = pick(0, vars + 1);
+            if (choice < vars) return std::string(1, 'a' + choice);
+            if (choice == vars) return std::to_string(pick(-5, 5));
+            return "9223372036854775000";
+        }
+        switch (pick(0, 4)) {
+            case 0:
+                return absl::StrFormat(
+                    "(if %s %s %s)", bool_expr(depth - 1, vars),
+                    int_expr(depth - 1, vars), int_expr(depth - 1, vars));
+            case 1: {
+                std::string value = int_expr(depth - 1, vars);
+                char name = 'a' + vars;
+                return absl::StrFormat("(let ((%c %s)) %s)", name, value,
+                                       int_expr(depth - 1, vars + 1));
+            }
+            default: {
+                const char* ops[] = {"+", "-", "*"};
+                return absl::StrFormat("(%s %s %s)", ops[pick(0, 2)],
+                                       int_expr(depth - 1, vars),
+                                       int_expr(depth - 1, vars));
+            }
+        }
+    }
+
+    std::string bool_expr(int depth, int vars) {
+        const char* ops[] = {"<", ">", "="};
+        return absl::StrFormat("(%s %s %s)", ops[pick(0, 2)],
+                               int_expr(depth, vars), int_expr(depth, vars));
+    }
+
+    std::mt19937 rng_;
+};
+
+TEST(JitTest, RandomPrograms) {
+    for (int seed = 0; seed < 200; seed++) {
+        expect_same(ProgramGenerator(seed).program());
+    }
+}
+
+}  // namespace
@@ -0,0 +1,56 @@
+#include "src/mapped_file.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include "absl/strings/str_format.h"
+
+namespace {
+
+std::string_view contents(const MappedFile& file) {
+    return std::string_view(file.data().data(), file.data().size());
+}
+
+// a path for a scratch file, under the test's temporary directory
+std::string temp_path(std::string_view name) {
+    const char* dir = std::getenv("TEST_TMPDIR");
+    return absl::StrFormat("%s/%s", dir != nullptr ? dir : "/tmp", name);
+}
+
+TEST(MappedFileTest, MapsRegularFiles) {
+    std::string path = temp_path("mapped_file_test.lisp");
+    std::string text = "(define x 1)\n";
+    for (int i = 0; i < 10000; i++) text += "(+ x 1)\n";
+    std::ofstream(path) << text;
+    auto file = MappedFile::open(path);
+    ASSERT_TRUE(file.ok()) << file.status();
+    EXPECT_EQ(contents(**file), text);
+
+    std::ofstream(path).close();
+    file = MappedFile::open(path);
+    ASSERT_TRUE(file.ok()) << file.status();
+    EXPECT_TRUE((*file)->data().empty());
+    unlink(path.c_str());
+
+    EXPECT_FALSE(MappedFile::open(temp_path("no-such-file")).ok());
+}
+
+TEST(MappedFileTest, ReadsPipes) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    // small enough to fit in the pipe's buffer without a reader
+    std::string text = "(define x 1)\n(+ x 1)\n";
+    ASSERT_EQ(write(fds[1], text.data(), text.size()), text.size());
+    close(fds[1]);
+    auto file = MappedFile::open(absl::StrFormat("/dev/fd/%d", fds[0]));
+    close(fds[0]);
+    ASSERT_TRUE(file.ok()) << file.status();
+    EXPECT_EQ(contents(**file), text);
+}
+
+}  // namespace
@@ -0,0 +1,202 @@
+#include "src/memo.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_format.h"
+#include "src/cgen.h"
+#include "src/evaluator.h"
+
+namespace {
+
+std::vector<TaggedValue> ints(std::initializer_list<int64_t> values) {
+    std::vector<TaggedValue> args;
+    for (int64_t i : values) args.push_back(TaggedValue::integer(i));
+    return args;
+}
+
+TEST(MemoCacheTest, FindsInsertedResults) {
+    MemoCache cache(8);
+    EXPECT_EQ(cache.find(ints({1, 2})), nullptr);
+    cache.insert(ints({1, 2}), TaggedValue::integer(3));
+    const TaggedValue* hit = cache.find(ints({1, 2}));
+    ASSERT_NE(hit, nullptr);
+    EXPECT_EQ(hit->as.i, 3);
+    EXPECT_EQ(cache.find(ints({2, 1})), nullptr);
+
+    // keys compare types as well as payloads
+    std::vector<TaggedValue> args = {TaggedValue::boolean(false),
+                                     TaggedValue::nil()};
+    cache.insert(args, TaggedValue::integer(4));
+    EXPECT_NE(cache.find(args), nullptr);
+    EXPECT_EQ(cache.find(ints({0, 0})), nullptr);
+
+    EXPECT_EQ(cache.stats().hits, 2);
+    EXPECT_EQ(cache.stats().misses, 3);
+}
+
+TEST(MemoCacheTest, EvictsOnceFull) {
+    MemoCache cache(4);
+    for (int i = 0; i < 4; i++) {
+        cache.insert(ints({i}), TaggedValue::integer(i));
+    }
+    // entries that were looked up get a second chance
+    EXPECT_NE(cache.find(ints({0})), nullptr);
+    EXPECT_NE(cache.find(ints({1})), nullptr);
+    cache.insert(ints({4}), TaggedValue::integer(4));
+    EXPECT_EQ(cache.size(), 4);
+    EXPECT_EQ(cache.stats().evictions, 1);
+    EXPECT_NE(cache.find(ints({0})), nullptr);
+    EXPECT_NE(cache.find(ints({1})), nullptr);
+    EXPECT_EQ(cache.find(ints({2})), nullptr);
+    EXPECT_NE(cache.find(ints({4})), nullptr);
+
+    for (int i = 5; i < 100; i++) {
+        cache.insert(ints({i}), TaggedValue::integer(i));
+    }
+    EXPECT_EQ(cache.size(), 4);
+    EXPECT_EQ(cache.stats().evictions, 96);
+}
+
+TEST(MemoCacheTest, SkipsUncacheableArguments) {
+    MemoCache cache(4);
+    std::vector<TaggedValue> args = {TaggedValue::pair(nullptr)};
+    cache.insert(args, TaggedValue::integer(1));
+    EXPECT_EQ(cache.find(args), nullptr);
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_EQ(cache.stats().uncacheable, 1);
+    EXPECT_EQ(cache.stats().misses, 0);
+
+    MemoCache disabled(0);
+    disabled.insert(ints({1}), TaggedValue::integer(1));
+    EXPECT_EQ(disabled.find(ints({1})), nullptr);
+}
+
+struct Result {
+    std::string output;
+    std::vector<absl::Status> errors;
+    MemoStats stats;
+};
+
+Result evaluate(const std::vector<std::string>& lines, int capacity = 1024,
+                bool jit = false) {
+    std::ostringstream out;
+    std::vector<absl::Status> errors;
+    Evaluator eval([&](absl::Status status) { errors.push_back(status); });
+    eval.set_interactive(true);
+    eval.set_optimize(true);
+    eval.set_jit(jit);
+    eval.set_memo_capacity(capacity);
+    eval.set_output(&out);
+    for (const auto& line : lines) eval.evaluate(line);
+    return Result{
+        .output = out.str(), .errors = errors, .stats = eval.memo_stats()};
+}
+
+TEST(MemoTest, CachesResults) {
+    // without the cache this would make about 10^16 calls
+    Result result = evaluate({
+        "(define-memo (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))",
+        "(fib 80)",
+        "(fib 80)",
+    });
+    EXPECT_EQ(result.output, "23416728348467685\n23416728348467685\n");
+    EXPECT_TRUE(result.errors.empty());
+    EXPECT_EQ(result.stats.misses, 81);
+    EXPECT_EQ(result.stats.hits, 79);
+    EXPECT_EQ(result.stats.evictions, 0);
+}
+
+TEST(MemoTest, SameResultsAsDefine) {
+    auto program = [](std::string_view define) -> std::vector<std::string> {
+        return {
+            absl::StrFormat("(%s (f n k) (if (< n 1) k "
+                            "(let ((a (f (- n 1) (+ k 1)))) "
+                            "(- a (f (- n 2) k)))))",
+                            define),
+            absl::StrFormat(
+                "(%s (g n) (if (= n 0) nil (cons (f n n) (g (- n 1)))))",
+                define),
+            "(f 20 7)",
+            "(f 0 0)",
+            "(g 10)",
+            "(let ((x (f 3 2))) (+ x (f 3 2)))",
+        };
+    };
+    for (bool jit : {false, true}) {
+        Result want = evaluate(program("define"), 1024, jit);
+        ASSERT_TRUE(want.errors.empty()) << want.errors[0];
+        // a tiny cache evicts all the time, which mustn't change anything
+        for (int capacity : {1024, 3, 0}) {
+            Result got = evaluate(program("define-memo"), capacity, jit);
+            EXPECT_EQ(got.output, want.output) << capacity;
+            EXPECT_TRUE(got.errors.empty()) << capacity;
+        }
+    }
+}
+
+TEST(MemoTest, RespectsCapacity) {
+    Result result = evaluate(
+        {
+            "(define-memo (id n) n)",
+            "(define (loop n) "
+            "(if (= n 0) 0 (let ((x (id n))) (loop (- n 1)))))",
+            "(loop 1000)",
+            "(loop 1000)",
+        },
+        100);
+    EXPECT_TRUE(result.errors.empty());
+    EXPECT_EQ(result.stats.misses, 2000);
+    EXPECT_EQ(result.stats.evictions, 1900);
+}
+
+TEST(MemoTest, CountsUncacheableCalls) {
+    Result result = evaluate({
+        "(define-memo (len xs) (if (nil? xs) 0 (+ 1 (len (cdr xs)))))",
+        "(len (cons 1 (cons 2 nil)))",
+        "(len nil)",
+    });
+    EXPECT_EQ(result.output, "2\n0\n");
+    EXPECT_EQ(result.stats.uncacheable, 2);
+    EXPECT_EQ(result.stats.misses, 1);
+    EXPECT_EQ(result.stats.hits, 1);
+}
+
+TEST(MemoTest, CachedResultsSurviveCollection) {
+    Result result = evaluate({
+        "(define-memo (range n) (if (= n 0) nil (cons n (range (- n 1)))))",
+        "(define (sum xs) (if (nil? xs) 0 (+ (car xs) (sum (cdr xs)))))",
+        "(define (churn n) (if (= n 0) 0 "
+        "(let ((x (cons n n))) (churn (- n 1)))))",
+        "(sum (range 100))",
+        "(churn 1000000)",
+        "(sum (range 100))",
+    });
+    EXPECT_TRUE(result.errors.empty());
+    EXPECT_EQ(result.output, "5050\n0\n5050\n");
+}
+
+TEST(MemoTest, RejectsNonFunctions) {
+    Result result = evaluate({
+        "(define-memo x 1)",
+        "(define-memo (f x) x x)",
+    });
+    ASSERT_EQ(result.errors.size(), 2);
+    EXPECT_NE(result.errors[0].ToString().find("define-memo needs a function"),
+              std::string::npos);
+}
+
+TEST(MemoTest, NotCompiledToC) {
+    Evaluator eval([](absl::Status status) { ADD_FAILURE() << status; });
+    auto chunk = eval.compile("(define-memo (f x) x)");
+    ASSERT_TRUE(chunk.ok());
+    EXPECT_EQ(emit_c(chunk->view()).status().code(),
+              absl::StatusCode::kUnimplemented);
+}
+
+}  // namespace
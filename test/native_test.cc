@@ -0,0 +1,193 @@
+#include "src/native.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "src/cgen.h"
+#include "src/embed.h"
+#include "src/evaluator.h"
+#include "src/parallel.h"
+
+namespace {
+
+std::shared_ptr<Natives> make_natives() {
+    auto natives = std::make_shared<Natives>();
+    EXPECT_TRUE(
+        natives->define("square", [](int64_t x) { return x * x; }).ok());
+    EXPECT_TRUE(natives
+                    ->define("clamp",
+                             [](int64_t x, int64_t lo, int64_t hi) {
+                                 return std::clamp(x, lo, hi);
+                             })
+                    .ok());
+    EXPECT_TRUE(natives->define("not", [](bool b) { return !b; }).ok());
+    EXPECT_TRUE(
+        natives->define("same", [](TaggedValue v) { return v; }).ok());
+    EXPECT_TRUE(natives->define("nothing", [] {}).ok());
+    EXPECT_TRUE(natives
+                    ->define("checked-div",
+                             [](int64_t a,
+                                int64_t b) -> absl::StatusOr<int64_t> {
+                                 if (b == 0) {
+                                     return absl::OutOfRangeError(
+                                         "division by zero");
+                                 }
+                                 return a / b;
+                             })
+                    .ok());
+    return natives;
+}
+
+struct Result {
+    std::string output;
+    std::vector<absl::Status> errors;
+};
+
+// evaluates each of |lines| interactively with |natives|
+Result evaluate(const std::vector<std::string>& lines, const Natives& natives,
+                bool jit = false) {
+    std::ostringstream out;
+    std::vector<absl::Status> errors;
+    Evaluator eval([&](absl::Status status) { errors.push_back(status); });
+    eval.set_interactive(true);
+    eval.set_optimize(true);
+    eval.set_jit(jit);
+    eval.set_natives(&natives);
+    eval.set_output(&out);
+    for (const auto& line : lines) eval.evaluate(line);
+    return Result{.output = out.str(), .errors = errors};
+}
+
+bool contains(const absl::Status& status, std::string_view text) {
+    return status.ToString().find(text) != std::string::npos;
+}
+
+TEST(NativeTest, CallsFunctions) {
+    auto natives = make_natives();
+    Result result = evaluate(
+        {
+            "(square 7)",
+            "(clamp 12 0 10) (clamp (square -3) 0 10)",
+            "(not #f)",
+            "(same (cons 1 2)) (same nil)",
+            "(nothing)",
+            "(checked-div 7 2)",
+            "(define (sum-squares n) (if (= n 0) 0 "
+            "(+ (square n) (sum-squares (- n 1)))))",
+            "(sum-squares 10)",
+        },
+        *natives);
+    EXPECT_EQ(result.output, "49\n10\n9\ntrue\n(1 . 2)\nnil\nnil\n3\n385\n");
+    EXPECT_TRUE(result.errors.empty());
+}
+
+TEST(NativeTest, VariablesHideFunctions) {
+    auto natives = make_natives();
+    Result result = evaluate(
+        {
+            "(let ((square (lambda (x) 0))) (square 3))",
+            "((lambda (square) (square 3)) (lambda (x) 1))",
+            "(define (square x) 2)",
+            "(square 3)",
+        },
+        *natives);
+    EXPECT_EQ(result.output, "0\n1\n2\n");
+    EXPECT_TRUE(result.errors.empty());
+}
+
+TEST(NativeTest, ReportsErrors) {
+    auto natives = make_natives();
+    int calls = 0;
+    ASSERT_TRUE(natives
+                    ->define("count",
+                             [&calls](int64_t x) {
+                                 calls++;
+                                 return x;
+                             })
+                    .ok());
+    Result result = evaluate(
+        {
+            "(count #t)",
+            "(square (+ 4611686018427387904 4611686018427387904))",
+            "(checked-div 1 0)",
+            "(square 1 2)",
+            "(define f square)",
+        },
+        *natives);
+    EXPECT_EQ(calls, 0);
+    ASSERT_EQ(result.errors.size(), 5);
+    EXPECT_TRUE(contains(result.errors[0], "vm: count: "));
+    EXPECT_TRUE(contains(result.errors[0], "type error: want Int, got Bool"));
+    EXPECT_TRUE(contains(result.errors[1], "want Int, got BigInt"));
+    EXPECT_EQ(result.errors[2].code(), absl::StatusCode::kOutOfRange);
+    EXPECT_TRUE(contains(result.errors[2], "checked-div: "));
+    EXPECT_TRUE(contains(result.errors[2], "division by zero"));
+    EXPECT_TRUE(contains(result.errors[3], "square takes 1 arguments, got 2"));
+    EXPECT_TRUE(contains(result.errors[4], "can only be called"));
+}
+
+TEST(NativeTest, RejectsBadDefinitions) {
+    Natives natives;
+    EXPECT_TRUE(natives.define("f", [] {}).ok());
+    EXPECT_FALSE(natives.define("f", [](int64_t x) { return x; }).ok());
+    EXPECT_FALSE(natives.define("car", [](TaggedValue v) { return v; }).ok());
+    EXPECT_EQ(natives.functions().size(), 1);
+    EXPECT_EQ(natives.lookup("f"), 0);
+    EXPECT_EQ(natives.lookup("g"), std::nullopt);
+}
+
+TEST(NativeTest, HotLoopsWithTheJit) {
+    auto natives = make_natives();
+    std::vector<std::string> lines = {
+        "(define (loop n acc) (if (= n 0) acc "
+        "(loop (- n 1) (+ acc (clamp (square n) 0 1000)))))",
+        "(loop 10000 0)",
+    };
+    Result interpreted = evaluate(lines, *natives);
+    Result compiled = evaluate(lines, *natives, true);
+    EXPECT_EQ(interpreted.output, "9979416\n");
+    EXPECT_EQ(compiled.output, interpreted.output);
+}
+
+TEST(NativeTest, SharedByIsolates) {
+    auto natives = make_natives();
+    std::atomic<int> calls = 0;
+    ASSERT_TRUE(natives->define("tick", [&calls] { calls++; }).ok());
+    auto program = compile_program(
+        "(define (ticks n) "
+        "(if (= n 0) 0 (let ((x (tick))) (ticks (- n 1)))))\n"
+        "(ticks 100)",
+        {.natives = natives});
+    ASSERT_TRUE(program.ok()) << program.status();
+    natives.reset();
+
+    std::vector<std::function<void()>> tasks(16, [&program] {
+        Isolate isolate(*program);
+        EXPECT_TRUE(isolate.run().ok());
+    });
+    run_parallel(4, std::move(tasks));
+    EXPECT_EQ(calls, 1600);
+}
+
+TEST(NativeTest, NotCompiledToC) {
+    auto natives = make_natives();
+    Evaluator eval([](absl::Status status) { ADD_FAILURE() << status; });
+    eval.set_natives(natives.get());
+    auto chunk = eval.compile("(square 2)");
+    ASSERT_TRUE(chunk.ok());
+    EXPECT_FALSE(emit_c(chunk->view()).ok());
+
+    // nor run without the natives they were compiled with
+    EXPECT_FALSE(Program::load(chunk->view()).ok());
+}
+
+}  // namespace
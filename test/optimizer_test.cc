@@ -0,0 +1,119 @@
+#include "src/optimizer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+#include "src/compiler.h"
+#include "src/evaluator.h"
+#include "src/instr.h"
+#include "src/parser.h"
+#include "src/scanner.h"
+
+namespace {
+
+// evaluates |text| interactively and returns everything it printed,
+// including errors without their pc, which depends on the optimizations
+std::string evaluate(std::string_view text, bool optimize) {
+    std::ostringstream out;
+    Evaluator eval([&out](absl::Status status) {
+        std::string message(status.message());
+        message.erase(0, message.find(' ') + 1);
+        out << "error: " << message << "\n";
+    });
+    eval.set_interactive(true);
+    eval.set_optimize(optimize);
+    eval.set_output(&out);
+    eval.evaluate(text);
+    return out.str();
+}
+
+std::vector<Instr> compile(std::string_view text, bool optimize) {
+    SymbolTable symbols;
+    auto toks = scan(text, &symbols);
+    EXPECT_TRUE(toks.ok());
+    Arena arena;
+    auto stmts = parse(*toks, &arena);
+    EXPECT_TRUE(stmts.ok());
+    Compiler compiler;
+    auto chunk = compiler.compile(*stmts);
+    EXPECT_TRUE(chunk.ok());
+    if (optimize) chunk = ::optimize(*chunk);
+    EXPECT_TRUE(chunk.ok());
+    auto code = decode(chunk->code);
+    EXPECT_TRUE(code.ok());
+    return *code;
+}
+
+int count(const std::vector<Instr>& code, Opcode op) {
+    return std::count_if(code.begin(), code.end(),
+                         [op](const Instr& instr) { return instr.op == op; });
+}
+
+TEST(OptimizerTest, SameResults) {
+    const char* programs[] = {
+        "1 #t #f -7",
+        "(let ((x 1) (y 2) (z 3)) y)",
+        "(let ((x 1) (y 2)) (let ((z 3) (w 4)) (if #t x w)))",
+        "(let ((a 1) (b 2)) (let ((c (let ((d 4)) d))) (if #f a c)))",
+        "(if #t 1 2) (if #f 1 2) (if (if #f #f #t) 3 4)",
+        "(let ((x #t)) (if x (let ((y 5) (z 6)) z) 7))",
+        "(let ((x 1) (y 2)) (let ((a x) (b y)) (if (let ((c #t)) c) a b)))",
+        "(if 1 2 3)",
+        "(let ((x 3)) (if x 1 2))",
+        "(let ((debug #f) (n 3)) (if debug 0 (let ((m n)) m)))",
+        "(let ((x 1) (x #t)) (if x x 2))",
+        "(let ((x 1)) (let ((y (if x 1 2))) 3))",
+        "(let ((a 1) (b 2)) ((lambda (x y) (let ((z x)) (cons y z))) a b))",
+        "(define (f x) (let ((y x)) y)) (f 1)",
+        "(let ((x 1)) (let ((y x)) (cons y x)))",
+        "(define (f x) (lambda (y) (cons x y))) ((f 1) 2) (f 1 2)",
+        "(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))) "
+        "(fib 10)",
+        "(define (f x y) (if (= x y) (* x 2) (if (> x y) (- x y) 0))) "
+        "(f 3 3) (f 5 3) (f 1 3) (f 1 nil)",
+    };
+    for (const char* program : programs) {
+        EXPECT_EQ(evaluate(program, false), evaluate(program, true))
+            << program;
+    }
+}
+
+TEST(OptimizerTest, FusesLetCleanup) {
+    auto code = compile("(let ((x 1) (y 2) (z 3)) (let ((w 4)) x))", true);
+    EXPECT_EQ(count(code, Opcode::Swap), 0);
+    EXPECT_EQ(count(code, Opcode::Slide), 1);
+    EXPECT_EQ(code.size(), compile("(let ((x 1) (y 2) (z 3)) (let ((w 4)) x))",
+                                   false).size() - 7);
+}
+
+TEST(OptimizerTest, FusesGets) {
+    auto code = compile("(let ((x #t) (y 2)) (if x y x))", true);
+    EXPECT_EQ(count(code, Opcode::Get2), 0);
+    code = compile("(let ((x 1) (y 2)) (let ((a x) (b y)) a))", true);
+    EXPECT_EQ(count(code, Opcode::Get2), 1);
+}
+
+TEST(OptimizerTest, FusesComparisons) {
+    auto code = compile(
+        "(define (f x y) (if (< x y) 1 (if (> x y) 2 (if (= x y) 3 4))))",
+        true);
+    EXPECT_EQ(count(code, Opcode::JmpIfNot), 0);
+    EXPECT_EQ(count(code, Opcode::JmpIfNotLt), 1);
+    EXPECT_EQ(count(code, Opcode::JmpIfNotGt), 1);
+    EXPECT_EQ(count(code, Opcode::JmpIfNotEq), 1);
+    code = compile("(define (f x y) (cons (< x y) 1))", true);
+    EXPECT_EQ(count(code, Opcode::Lt), 1);
+}
+
+TEST(OptimizerTest, FoldsConstantConditions) {
+    auto code = compile("(if #t 1 2)", true);
+    EXPECT_EQ(count(code, Opcode::JmpIfNot), 0);
+    code = compile("(if #f 1 2)", true);
+    EXPECT_EQ(count(code, Opcode::JmpIfNot), 0);
+    EXPECT_EQ(count(code, Opcode::Jmp), 2);
+}
+
+}  // namespace
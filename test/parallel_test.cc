@@ -0,0 +1,46 @@
+#include "src/parallel.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+
+namespace {
+
+TEST(ParallelTest, RunsEveryTaskOnce) {
+    for (int threads : {1, 2, 8, 100}) {
+        std::vector<std::atomic<int>> runs(50);
+        std::vector<std::function<void()>> tasks;
+        for (auto& count : runs) tasks.push_back([&count] { count++; });
+        run_parallel(threads, std::move(tasks));
+        for (const auto& count : runs) EXPECT_EQ(count, 1) << threads;
+    }
+    run_parallel(4, {});
+}
+
+TEST(ParallelTest, StealsFromBusyThreads) {
+    // Two threads get alternate tasks, and the first one the calling thread
+    // takes blocks until every other task has run, including the ones dealt
+    // to the calling thread. Only stealing can get them done.
+    constexpr int kTasks = 100;
+    std::atomic<int> done = 0;
+    absl::Notification all_done;
+    std::vector<std::function<void()>> tasks;
+    for (int i = 0; i < kTasks; i++) {
+        tasks.push_back([&] {
+            if (++done == kTasks - 1) all_done.Notify();
+        });
+    }
+    bool stolen = false;
+    tasks[kTasks - 2] = [&] {
+        stolen = all_done.WaitForNotificationWithTimeout(absl::Seconds(30));
+    };
+    run_parallel(2, std::move(tasks));
+    EXPECT_TRUE(stolen);
+}
+
+}  // namespace
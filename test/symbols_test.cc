@@ -0,0 +1,51 @@
+#include "src/symbols.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+
+namespace {
+
+TEST(SymbolsTest, InternsNamesOnce) {
+    SymbolTable symbols;
+    Symbol foo = symbols.intern("foo");
+    Symbol bar = symbols.intern("bar");
+    EXPECT_EQ(foo.id, 0);
+    EXPECT_EQ(bar.id, 1);
+    EXPECT_EQ(symbols.size(), 2);
+
+    // an equal name from different storage gets the same id and the
+    // stored copy of the name
+    std::string copy = "foo";
+    Symbol again = symbols.intern(copy);
+    EXPECT_EQ(again.id, foo.id);
+    EXPECT_EQ(again.name.data(), foo.name.data());
+    EXPECT_EQ(symbols.size(), 2);
+}
+
+TEST(SymbolsTest, DistinctNamesGetDistinctIds) {
+    SymbolTable symbols;
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_EQ(symbols.intern("x" + std::to_string(i)).id, i);
+    }
+    EXPECT_NE(symbols.intern("a").id, symbols.intern("A").id);
+    EXPECT_NE(symbols.intern("nil?").id, symbols.intern("nil").id);
+    EXPECT_EQ(symbols.size(), 1004);
+}
+
+TEST(SymbolsTest, NamesRoundTrip) {
+    SymbolTable symbols;
+    std::string name = "fib";
+    Symbol fib = symbols.intern(name);
+    // the table keeps its own copy
+    name = "xyz";
+    EXPECT_EQ(fib.name, "fib");
+    EXPECT_EQ(symbols.name(fib.id), "fib");
+    for (int i = 0; i < 1000; i++) symbols.intern("x" + std::to_string(i));
+    // names stay put as the table grows
+    EXPECT_EQ(symbols.name(fib.id).data(), fib.name.data());
+    EXPECT_EQ(symbols.name(symbols.intern("x500").id), "x500");
+}
+
+}  // namespace